@@ -0,0 +1,132 @@
+#include "ChatHandler.h"
+#include "MyReactor.h"
+
+
+ChatHandler::ChatHandler(MyReactor<ChatHandler>* reactor)
+    : m_reactor(reactor)
+{
+}
+
+
+bool ChatHandler::init()
+{
+    int maxfds = m_reactor->max_clients();
+    m_active.reserve(maxfds);
+    m_active_index.assign(maxfds, -1);
+    m_broadcast_targets.reserve(maxfds);
+
+    if(pthread_create(&m_send_threadid, NULL, send_thread_proc, (void*)this) != 0)
+        return false;
+    /* 绑定CPU时和主线程放在一起 */
+    m_reactor->add_thread(m_send_threadid);
+    return true;
+}
+
+
+void ChatHandler::uninit()
+{
+    m_send_tasks.notify();
+}
+
+
+void ChatHandler::on_connection(Connection* conn)
+{
+    int clientfd = conn->fd();
+
+    pthread_mutex_lock(&m_cli_mutex);
+    if(m_active_index[clientfd] == -1)
+    {
+        ActiveClient client;
+        client.fd = clientfd;
+        client.gen = m_reactor->client_gen(clientfd);
+        m_active_index[clientfd] = (int)m_active.size();
+        m_active.push_back(client);
+    }
+    pthread_mutex_unlock(&m_cli_mutex);
+}
+
+
+void ChatHandler::on_close(int clientfd)
+{
+    if(clientfd < 0 || clientfd >= (int)m_active_index.size())
+        return;
+
+    pthread_mutex_lock(&m_cli_mutex);
+    int index = m_active_index[clientfd];
+    if(index != -1)
+    {
+        /* 最后一个搬到空出来的位置 */
+        ActiveClient last = m_active.back();
+        m_active[index] = last;
+        m_active_index[last.fd] = index;
+        m_active.pop_back();
+        m_active_index[clientfd] = -1;
+    }
+    pthread_mutex_unlock(&m_cli_mutex);
+}
+
+
+void ChatHandler::on_high_water(Connection* conn, size_t len)
+{
+    LOG_INFO("output buffer reaches %d bytes, close slow client fd = %d\n", (int)len, conn->fd());
+    conn->close_later();
+}
+
+
+void ChatHandler::on_message(Connection* conn, Buffer* buf)
+{
+    LOG_DEBUG("client msg: %.*s", (int)buf->readable_bytes(), buf->peek());
+
+    /* 将消息加上时间戳 */
+    time_t now = time(NULL);
+    struct tm* nowstr = localtime(&now);
+    std::ostringstream ostimestr;
+    ostimestr << "[" << nowstr->tm_year + 1900 << "-"
+        << std::setw(2) << std::setfill('0') << nowstr->tm_mon + 1 << "-"
+        << std::setw(2) << std::setfill('0') << nowstr->tm_mday << " "
+        << std::setw(2) << std::setfill('0') << nowstr->tm_hour << ":"
+        << std::setw(2) << std::setfill('0') << nowstr->tm_min << ":"
+        /* << std::setw(2) << std::setfill('0') << nowstr->tm_sec << "]server reply: "; */
+        << std::setw(2) << std::setfill('0') << nowstr->tm_sec << " client"<< conn->fd() << " :";
+
+    /* 时间戳直接写在缓冲区的预留区，不必再拷贝一次消息 */
+    buf->prepend(ostimestr.str());
+    std::string strclientmsg = buf->retrieve_all_as_string();
+
+    m_send_tasks.post([this, strclientmsg]() {
+        broadcast(strclientmsg);
+    });
+}
+
+
+void* ChatHandler::send_thread_proc(void *args)
+{
+    ChatHandler* pHandler = static_cast<ChatHandler*>(args);
+    pHandler->m_reactor->attach_thread("send");
+
+    while(!pHandler->m_reactor->stopped())
+    {
+        /* 等待工作线程投递的广播任务 */
+        pHandler->m_send_tasks.wait();
+        pHandler->m_send_tasks.run_pending();
+    }
+
+    return NULL;
+}
+
+
+void ChatHandler::broadcast(const std::string& msg)
+{
+    LOG_DEBUG("send: %s\n", msg.c_str());
+
+    std::shared_ptr<const std::string> shared = std::make_shared<const std::string>(msg);
+
+    /* 锁内只做一次连续内存的复制，投递时不持有m_cli_mutex */
+    pthread_mutex_lock(&m_cli_mutex);
+    m_broadcast_targets.assign(m_active.begin(), m_active.end());
+    pthread_mutex_unlock(&m_cli_mutex);
+
+    /* 连接属于各自的线程，这里只投递，发送和EWOULDBLOCK后的续写都由拥有者完成 */
+    for(size_t i = 0; i < m_broadcast_targets.size(); i++)
+        m_reactor->deliver(m_broadcast_targets[i].fd, m_broadcast_targets[i].gen, shared);
+}
@@ -0,0 +1,60 @@
+#ifndef __CHATHANDLER_H
+#define __CHATHANDLER_H
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include "Connection.h"
+#include "Wakeup.h"
+
+template<typename Handler> class MyReactor;
+
+/* 正在接收广播的连接，gen是加入时连接的代数 */
+struct ActiveClient
+{
+    int fd;
+    uint32_t gen;
+};
+
+/* 聊天室协议：每条消息加上时间戳和发送者，由发送线程广播给所有客户 */
+class ChatHandler
+{
+    public:
+        explicit ChatHandler(MyReactor<ChatHandler>* reactor);
+
+        /* 按连接表的大小预留广播表，启动发送线程 */
+        bool init();
+        void uninit();
+        /* 连接注册后开始接收广播 */
+        void on_connection(Connection* conn);
+        void on_message(Connection* conn, Buffer* buf);
+        /* 聊天室不能为一个读得慢的客户停下来，积压超过高水位就断开它 */
+        void on_high_water(Connection* conn, size_t len);
+        /* 先退出广播表，发送线程手里的旧快照会因为gen不同而被丢弃 */
+        void on_close(int clientfd);
+
+    private:
+        static void *send_thread_proc(void* args);
+        /* 在发送线程把消息投递给所有客户 */
+        void broadcast(const std::string& msg);
+
+    private:
+        MyReactor<ChatHandler>* m_reactor;
+
+        pthread_t m_send_threadid;
+        /* 投递给发送线程的广播任务 */
+        TaskQueue m_send_tasks;
+
+        pthread_mutex_t m_cli_mutex = PTHREAD_MUTEX_INITIALIZER;
+        /*
+         * 正在接收广播的连接，紧凑排列，删除时用最后一个填补空位
+         * 按fd的上限预留，连接和断开都不会分配内存
+         */
+        std::vector<ActiveClient> m_active;
+        /* 以fd为下标，在m_active中的下标，不在表中时为-1，由m_cli_mutex保护 */
+        std::vector<int> m_active_index;
+        /* 发送线程广播时在锁内复制的快照，只由发送线程使用 */
+        std::vector<ActiveClient> m_broadcast_targets;
+};
+
+#endif
@@ -0,0 +1,240 @@
+#include "FileCache.h"
+#include "wrapper.h"
+
+#include <functional>
+#include <sstream>
+#include <time.h>
+
+
+static int64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+CachedFile::~CachedFile()
+{
+    if(fd != -1)
+        close(fd);
+}
+
+
+FileCache::FileCache()
+    : m_shard_entries(0),
+      m_shard_bytes(0),
+      m_ttl_ns(0)
+{
+    for(int i = 0; i < FILE_CACHE_SHARDS; i++)
+    {
+        Shard& shard = m_shards[i];
+        shard.bytes = 0;
+        shard.lookups = 0;
+        shard.hits = 0;
+        shard.revalidations = 0;
+        shard.evictions = 0;
+        shard.syscalls.store(0, std::memory_order_relaxed);
+    }
+}
+
+void FileCache::configure(size_t max_entries, size_t max_bytes, int ttl_ms)
+{
+    /* 条目数不到分片数时每个分片至少一个 */
+    m_shard_entries = max_entries == 0 ? 0 : (max_entries + FILE_CACHE_SHARDS - 1) / FILE_CACHE_SHARDS;
+    m_shard_bytes = max_bytes / FILE_CACHE_SHARDS;
+    m_ttl_ns = ttl_ms > 0 ? (int64_t)ttl_ms * 1000000 : 0;
+}
+
+int FileCache::lookup(const char* filename, size_t inline_max, CachedFilePtr* file)
+{
+    std::string path(filename);
+    int index = std::hash<std::string>()(path) % FILE_CACHE_SHARDS;
+    Shard* shard = &m_shards[index];
+    bool caching = m_shard_entries > 0;
+    int64_t now = now_ns();
+
+    /* 没过期的直接返回，不碰文件系统 */
+    CachedFilePtr cached;
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->lookups++;
+        if(caching)
+        {
+            auto it = shard->index.find(path);
+            if(it != shard->index.end())
+            {
+                EntryList::iterator entry = it->second;
+                if(now - entry->checked_ns < m_ttl_ns)
+                {
+                    shard->hits++;
+                    shard->lru.splice(shard->lru.begin(), shard->lru, entry);
+                    *file = entry->file;
+                    return 0;
+                }
+                cached = entry->file;
+            }
+        }
+    }
+
+    /* 过期了或者不在缓存里，stat一次看文件还是不是原来那个 */
+    struct stat st;
+    int rc = stat(filename, &st);
+    shard->syscalls.fetch_add(1, std::memory_order_relaxed);
+    if(rc == 0 && cached && same_file(*cached, st))
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->hits++;
+        shard->revalidations++;
+        auto it = shard->index.find(path);
+        if(it != shard->index.end() && it->second->file == cached)
+        {
+            it->second->checked_ns = now;
+            shard->lru.splice(shard->lru.begin(), shard->lru, it->second);
+        }
+        *file = cached;
+        return 0;
+    }
+
+    rc = rc != 0 ? ENOENT : (!S_ISREG(st.st_mode) || !(S_IRUSR & st.st_mode)) ? EACCES : 0;
+    std::shared_ptr<CachedFile> loaded;
+    if(rc == 0)
+    {
+        uint64_t syscalls = 0;
+        rc = load(filename, st, inline_max, &loaded, &syscalls);
+        shard->syscalls.fetch_add(syscalls, std::memory_order_relaxed);
+        if(rc == 0)
+            loaded->shard = index;
+    }
+
+    if(caching)
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        /* 换掉旧的条目，打开失败时旧的也不能再用 */
+        auto it = shard->index.find(path);
+        if(it != shard->index.end())
+            erase(shard, it->second);
+        if(rc == 0)
+            insert(shard, path, loaded, now);
+    }
+    if(rc != 0)
+        return rc;
+
+    *file = loaded;
+    return 0;
+}
+
+void FileCache::add_syscalls(const CachedFile& file, uint64_t n)
+{
+    m_shards[file.shard].syscalls.fetch_add(n, std::memory_order_relaxed);
+}
+
+int FileCache::load(const char* filename, const struct stat& st, size_t inline_max,
+        std::shared_ptr<CachedFile>* file, uint64_t* syscalls)
+{
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    (*syscalls)++;
+    if(fd < 0)
+        return EACCES;
+
+    std::shared_ptr<CachedFile> f = std::make_shared<CachedFile>();
+    f->size = st.st_size;
+    f->mtime = st.st_mtim;
+    f->inode = st.st_ino;
+    f->device = st.st_dev;
+    f->mode = st.st_mode;
+
+    char name[MAXLINE], filetype[MAXLINE];
+    snprintf(name, sizeof(name), "%s", filename);
+    get_filetype(name, filetype);
+    f->filetype = filetype;
+
+    if(f->size >= inline_max)
+    {
+        f->fd = fd;
+        *file = f;
+        return 0;
+    }
+
+    /* 小文件读进内存就关闭；stat之后被截短时按读到的长度，下次检查会发现变了 */
+    f->data.resize(f->size);
+    size_t got = 0;
+    while(got < f->size)
+    {
+        ssize_t n = pread(fd, &f->data[got], f->size - got, got);
+        (*syscalls)++;
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            break;
+        got += n;
+    }
+    close(fd);
+    (*syscalls)++;
+    f->data.resize(got);
+    f->size = got;
+    *file = f;
+    return 0;
+}
+
+bool FileCache::same_file(const CachedFile& file, const struct stat& st)
+{
+    return file.inode == st.st_ino && file.device == st.st_dev && file.size == (size_t)st.st_size
+        && file.mode == st.st_mode
+        && file.mtime.tv_sec == st.st_mtim.tv_sec && file.mtime.tv_nsec == st.st_mtim.tv_nsec;
+}
+
+void FileCache::insert(Shard* shard, const std::string& path, const CachedFilePtr& file, int64_t now)
+{
+    /* 一个分片都放不下的不缓存 */
+    if(file->data.size() > m_shard_bytes)
+        return;
+
+    shard->lru.push_front(Entry{path, file, now});
+    shard->index[path] = shard->lru.begin();
+    shard->bytes += file->data.size();
+
+    while(shard->lru.size() > m_shard_entries || shard->bytes > m_shard_bytes)
+    {
+        erase(shard, std::prev(shard->lru.end()));
+        shard->evictions++;
+    }
+}
+
+void FileCache::erase(Shard* shard, EntryList::iterator it)
+{
+    /* 正在发送的请求还拿着引用，fd等它们用完才关闭 */
+    shard->bytes -= it->file->data.size();
+    shard->index.erase(it->path);
+    shard->lru.erase(it);
+}
+
+std::string FileCache::to_json() const
+{
+    size_t entries = 0, bytes = 0;
+    uint64_t lookups = 0, hits = 0, revalidations = 0, evictions = 0, syscalls = 0;
+    for(int i = 0; i < FILE_CACHE_SHARDS; i++)
+    {
+        const Shard& shard = m_shards[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        entries += shard.index.size();
+        bytes += shard.bytes;
+        lookups += shard.lookups;
+        hits += shard.hits;
+        revalidations += shard.revalidations;
+        evictions += shard.evictions;
+        syscalls += shard.syscalls.load(std::memory_order_relaxed);
+    }
+
+    std::ostringstream os;
+    os << "{\"entries\":" << entries << ",\"bytes\":" << bytes
+       << ",\"lookups\":" << lookups << ",\"hits\":" << hits << ",\"misses\":" << lookups - hits
+       << ",\"revalidations\":" << revalidations << ",\"evictions\":" << evictions
+       << ",\"syscalls\":" << syscalls;
+    char buf[96];
+    snprintf(buf, sizeof(buf), ",\"hit_rate\":%.4f,\"syscalls_per_request\":%.2f}",
+            lookups > 0 ? (double)hits / lookups : 0.0,
+            lookups > 0 ? (double)syscalls / lookups : 0.0);
+    os << buf;
+    return os.str();
+}
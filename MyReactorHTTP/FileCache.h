@@ -0,0 +1,123 @@
+#ifndef __FILECACHE_H
+#define __FILECACHE_H
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+/* 分片个数，按路径的哈希选分片，每个分片一把锁 */
+#define FILE_CACHE_SHARDS 16
+
+/* 默认的条目数、缓存内容的字节数上限和重新检查的间隔 */
+#define FILE_CACHE_ENTRIES 1024
+#define FILE_CACHE_BYTES (64 * 1024 * 1024)
+#define FILE_CACHE_TTL_MS 1000
+
+/*
+ * 一个打开过的静态文件：小文件的内容读进data，fd已经关闭；
+ * 大文件保留打开的fd，发送时dup一份交给连接。最后一个引用释放时关闭fd
+ */
+struct CachedFile
+{
+    CachedFile() : fd(-1), size(0), inode(0), device(0), mode(0), shard(0) {}
+    ~CachedFile();
+
+    bool in_memory() const { return fd == -1; }
+
+    int fd;
+    size_t size;
+    struct timespec mtime;
+    ino_t inode;
+    dev_t device;
+    /* 权限被改掉时修改时间不变，要单独比较 */
+    mode_t mode;
+    std::string filetype;
+    std::string data;
+    /* 所在的分片，serve_static记系统调用次数用 */
+    int shard;
+};
+
+typedef std::shared_ptr<const CachedFile> CachedFilePtr;
+
+/*
+ * 路径到打开的文件、大小、修改时间和类型的缓存，分片加锁，每个分片按LRU淘汰
+ * 条目数和读进内存的字节数都有上限，平均分到各分片
+ * 不用inotify，命中时距上次检查超过ttl_ms才stat一次，inode、大小、修改时间或权限变了就重新打开；
+ * ttl_ms为0时每次都stat，但省掉了open、mmap和close
+ * max_entries为0时不缓存，每次都打开文件，统计照样记，方便对比
+ */
+class FileCache
+{
+    public:
+        FileCache();
+
+        void configure(size_t max_entries, size_t max_bytes, int ttl_ms);
+
+        /*
+         * 查找filename，不在缓存里或者已经过期时打开它，小于inline_max的文件读进内存
+         * 成功返回0；文件不存在返回ENOENT，不是普通文件或者不可读返回EACCES
+         */
+        int lookup(const char* filename, size_t inline_max, CachedFilePtr* file);
+
+        /* 缓存之外为这个文件做的系统调用，比如发送时的dup或mmap */
+        void add_syscalls(const CachedFile& file, uint64_t n);
+
+        /* 查找、命中、重新检查、淘汰的次数，命中率和每个请求的文件系统调用数 */
+        std::string to_json() const;
+
+    private:
+        FileCache(const FileCache& rhs);
+        FileCache& operator = (const FileCache& rhs);
+
+        struct Entry
+        {
+            std::string path;
+            CachedFilePtr file;
+            /* 上次确认文件没变的时间，单调时钟纳秒 */
+            int64_t checked_ns;
+        };
+        typedef std::list<Entry> EntryList;
+
+        /* 分片的计数器在锁里更新，只有syscalls在锁外加 */
+        struct alignas(CACHE_LINE_SIZE) Shard
+        {
+            mutable std::mutex mutex;
+            /* 最近用过的在前面 */
+            EntryList lru;
+            std::unordered_map<std::string, EntryList::iterator> index;
+            size_t bytes;
+            uint64_t lookups;
+            uint64_t hits;
+            uint64_t revalidations;
+            uint64_t evictions;
+            std::atomic<uint64_t> syscalls;
+        };
+
+        /* 打开并检查文件，syscalls加上用掉的系统调用数 */
+        static int load(const char* filename, const struct stat& st, size_t inline_max,
+                std::shared_ptr<CachedFile>* file, uint64_t* syscalls);
+        static bool same_file(const CachedFile& file, const struct stat& st);
+
+        /* 调用者持有分片的锁 */
+        void insert(Shard* shard, const std::string& path, const CachedFilePtr& file, int64_t now);
+        void erase(Shard* shard, EntryList::iterator it);
+
+    private:
+        Shard m_shards[FILE_CACHE_SHARDS];
+        size_t m_shard_entries;
+        size_t m_shard_bytes;
+        int64_t m_ttl_ns;
+};
+
+#endif
@@ -0,0 +1,153 @@
+#include "HttpHandler.h"
+#include "MyReactor.h"
+#include "wrapper.h"
+
+
+/* 挂在连接上的状态 */
+struct HttpSession
+{
+    /* 这个连接上已经处理的请求数 */
+    int requests = 0;
+    /* 已经回复了Connection: close，之后收到的数据都丢掉 */
+    bool closing = false;
+    /* 没收完的请求解析到哪里了，下次可读时接着解析 */
+    HttpParser parser;
+};
+
+
+HttpHandler::HttpHandler(MyReactor<HttpHandler>* reactor)
+    : m_reactor(reactor)
+{
+}
+
+
+bool HttpHandler::load_config(const char* config_file)
+{
+    std::map<std::string, std::string> configs;
+    if(get_config_map(config_file, configs) != 0)
+        return false;
+
+    if(configs.count("keepalive_requests"))
+        m_keepalive_requests = atoi(configs["keepalive_requests"].c_str());
+    if(configs.count("keepalive_timeout"))
+        m_keepalive_timeout = atoi(configs["keepalive_timeout"].c_str());
+    if(configs.count("sendfile_threshold"))
+        set_sendfile_threshold(atol(configs["sendfile_threshold"].c_str()));
+    if(configs.count("file_cache_entries"))
+        m_file_cache_entries = atol(configs["file_cache_entries"].c_str());
+    if(configs.count("file_cache_bytes"))
+        m_file_cache_bytes = atol(configs["file_cache_bytes"].c_str());
+    if(configs.count("file_cache_ttl_ms"))
+        m_file_cache_ttl_ms = atoi(configs["file_cache_ttl_ms"].c_str());
+    return true;
+}
+
+
+bool HttpHandler::init()
+{
+    set_file_cache(m_file_cache_entries > 0 ? m_file_cache_entries : 0,
+            m_file_cache_bytes > 0 ? m_file_cache_bytes : 0, m_file_cache_ttl_ms);
+
+    /* GET /__stats由处理连接的线程直接回复当前的统计，文件缓存的统计放在最后 */
+    set_stats_provider([this]() {
+        std::string json = m_reactor->stats_json();
+        json.insert(json.size() - 1, ",\"file_cache\":" + file_cache_json());
+        return json;
+    });
+    return true;
+}
+
+
+void HttpHandler::on_connection(Connection* conn)
+{
+    conn->set_context(std::make_shared<HttpSession>());
+}
+
+
+void HttpHandler::on_message(Connection* conn, Buffer* buf)
+{
+    HttpSession* session = static_cast<HttpSession*>(conn->context().get());
+    if(session->closing)
+    {
+        buf->retrieve_all();
+        return;
+    }
+
+    std::string response;
+    int keep_alive = 1;
+    HttpCgi cgi;
+    while(keep_alive)
+    {
+        /* 请求头以空行结束，没收到完整的请求就等下一次可读 */
+        HttpParser::Result result = session->parser.parse(buf->peek(), buf->readable_bytes());
+        if(result == HttpParser::HTTP_NEED_MORE)
+            break;
+        if(result == HttpParser::HTTP_BAD)
+        {
+            LOG_ERROR("bad or too large request, fd = %d\n", conn->fd());
+            clienterror(&response, 0, "request", "400", "Bad Request",
+                    "Tiny couldn't parse the request");
+            keep_alive = 0;
+            break;
+        }
+
+        session->requests++;
+        keep_alive = m_keepalive_requests <= 0 || session->requests < m_keepalive_requests;
+        HttpFile file;
+        int ret = doit(session->parser.request(), &response, &keep_alive, &file, &cgi);
+        buf->retrieve(session->parser.length());
+        session->parser.reset();
+        if(ret == -1)
+        {
+            LOG_ERROR("bad request, client disconnected, fd = %d\n", conn->fd());
+            keep_alive = 0;
+            break;
+        }
+
+        /* 大文件连同前面攒下的回复交给连接，后面的回复排在文件之后 */
+        if(file.fd != -1)
+        {
+            if(!conn->send_file(response, file.fd, 0, file.size))
+            {
+                LOG_ERROR("send error, fd = %d\n", conn->fd());
+                keep_alive = 0;
+            }
+            response.clear();
+        }
+    }
+
+    /* 同一次读到的多个请求的回复按顺序一起发送 */
+    if(!response.empty() && !conn->send(response.data(), response.size()))
+        LOG_ERROR("send error, fd = %d\n", conn->fd());
+    /* 要关闭的回复之后的请求不再处理，回复写完再关闭 */
+    if(!keep_alive)
+    {
+        session->closing = true;
+        buf->retrieve_all();
+        if(cgi.filename.empty())
+            conn->close_after_write();
+        else
+            run_cgi(conn, cgi);
+    }
+}
+
+
+void HttpHandler::run_cgi(Connection* conn, const HttpCgi& cgi)
+{
+    /* CGI阻塞到程序退出，不占用反应堆线程；回复排在前面的回复之后，发送完关闭连接 */
+    int clientfd = conn->fd();
+    uint32_t gen = m_reactor->client_gen(clientfd);
+    MyReactor<HttpHandler>* reactor = m_reactor;
+    m_reactor->submit([reactor, clientfd, gen, cgi]() {
+        std::shared_ptr<std::string> reply = std::make_shared<std::string>();
+        serve_dynamic(reply.get(), cgi.filename.c_str(), cgi.cgiargs.c_str());
+        reactor->deliver(clientfd, gen, reply, true);
+    });
+}
+
+
+void HttpHandler::on_high_water(Connection* conn, size_t len)
+{
+    LOG_INFO("output buffer reaches %d bytes, pause reading fd = %d\n", (int)len, conn->fd());
+    conn->set_reading(false);
+}
@@ -0,0 +1,48 @@
+#ifndef __HTTPHANDLER_H
+#define __HTTPHANDLER_H
+
+#include "Connection.h"
+#include "FileCache.h"
+
+template<typename Handler> class MyReactor;
+struct HttpCgi;
+
+/*
+ * Tiny Web服务器：用HttpParser在输入缓冲区上切出完整的请求交给doit，一批请求的回复按顺序合在一起发送
+ * HTTP/1.1的连接默认保持，一个连接上的请求数达到上限后回复Connection: close并关闭
+ */
+class HttpHandler
+{
+    public:
+        explicit HttpHandler(MyReactor<HttpHandler>* reactor);
+
+        /* 从配置文件读取保持连接的请求数上限和空闲秒数，文件打不开时返回false */
+        bool load_config(const char* config_file);
+        /* 保持的连接空闲多少秒后关闭，交给反应堆的空闲检测 */
+        int keepalive_timeout() const { return m_keepalive_timeout; }
+
+        /* 按配置打开静态文件缓存，GET /__stats回复反应堆和文件缓存当前的统计 */
+        bool init();
+        void uninit() {}
+        void on_connection(Connection* conn);
+        void on_message(Connection* conn, Buffer* buf);
+        /* 对端不读的时候不再读它的请求，积压写出去之后再恢复 */
+        void on_high_water(Connection* conn, size_t len);
+        void on_close(int clientfd) {}
+
+    private:
+        /* 在工作线程上运行CGI程序，回复投递回连接 */
+        void run_cgi(Connection* conn, const HttpCgi& cgi);
+
+    private:
+        MyReactor<HttpHandler>* m_reactor;
+        /* 一个连接最多处理的请求数，0表示不限制 */
+        int m_keepalive_requests = 1000;
+        int m_keepalive_timeout = 60;
+        /* 静态文件缓存的条目数、内容字节数上限和重新检查的毫秒数 */
+        long m_file_cache_entries = FILE_CACHE_ENTRIES;
+        long m_file_cache_bytes = FILE_CACHE_BYTES;
+        int m_file_cache_ttl_ms = FILE_CACHE_TTL_MS;
+};
+
+#endif
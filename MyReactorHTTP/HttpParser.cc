@@ -0,0 +1,169 @@
+#include "HttpParser.h"
+#include "HttpScan.h"
+#include <string.h>
+#include <strings.h>
+
+
+static bool equals_nocase(std::string_view a, std::string_view b)
+{
+    return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+/* 逗号分隔的列表里有没有token，比如Connection: keep-alive, Upgrade */
+static bool has_token(std::string_view list, std::string_view token)
+{
+    while(!list.empty())
+    {
+        size_t comma = list.find(',');
+        std::string_view item = list.substr(0, comma);
+        while(!item.empty() && (item.front() == ' ' || item.front() == '\t'))
+            item.remove_prefix(1);
+        while(!item.empty() && (item.back() == ' ' || item.back() == '\t'))
+            item.remove_suffix(1);
+        if(equals_nocase(item, token))
+            return true;
+        if(comma == std::string_view::npos)
+            break;
+        list.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+
+std::string_view HttpRequest::header(std::string_view name) const
+{
+    for(size_t i = 0; i < headers.size(); i++)
+    {
+        if(equals_nocase(headers[i].name, name))
+            return headers[i].value;
+    }
+    return std::string_view();
+}
+
+bool HttpRequest::has_header(std::string_view name) const
+{
+    for(size_t i = 0; i < headers.size(); i++)
+    {
+        if(equals_nocase(headers[i].name, name))
+            return true;
+    }
+    return false;
+}
+
+bool HttpRequest::keep_alive() const
+{
+    std::string_view connection = header("Connection");
+    if(has_token(connection, "close"))
+        return false;
+    if(has_token(connection, "keep-alive"))
+        return true;
+    return version == "HTTP/1.1";
+}
+
+
+void HttpParser::reset()
+{
+    m_state = STATE_REQUEST_LINE;
+    m_pos = 0;
+    m_header_spans.clear();
+    m_request.headers.clear();
+}
+
+HttpParser::Result HttpParser::parse(const char* data, size_t len)
+{
+    if(m_state == STATE_DONE)
+        return HTTP_DONE;
+
+    while(true)
+    {
+        /*
+         * 一行一行地往后走，不完整的行下次从它的开头重新找
+         * 行里不能有控制字符，找行尾的同时就检查了，第一个控制字符必须是行尾的\r\n或者\n
+         */
+        size_t begin = m_pos;
+        size_t end = begin + scan_text(data + begin, len - begin);
+        if(end == len || (data[end] == '\r' && end + 1 == len))
+            return len > HTTP_MAX_REQUEST ? HTTP_BAD : HTTP_NEED_MORE;
+        if(data[end] == '\r' && data[end + 1] == '\n')
+            m_pos = end + 2;
+        else if(data[end] == '\n')
+            m_pos = end + 1;
+        else
+            return HTTP_BAD;
+        if(m_pos > HTTP_MAX_REQUEST)
+            return HTTP_BAD;
+
+        if(m_state == STATE_REQUEST_LINE)
+        {
+            /* 请求行之前的空行忽略掉，流水线上前一个请求后面多出的空行也是；总长度仍受HTTP_MAX_REQUEST限制 */
+            if(end == begin)
+                continue;
+            if(!parse_request_line(data, begin, end))
+                return HTTP_BAD;
+            m_state = STATE_HEADERS;
+            continue;
+        }
+
+        if(end == begin)
+            break;
+        if(!parse_header(data, begin, end))
+            return HTTP_BAD;
+    }
+
+    /* 数据不会再搬动了，把偏移换成指针 */
+    m_state = STATE_DONE;
+    m_request.method = view(data, m_method);
+    m_request.uri = view(data, m_uri);
+    m_request.version = view(data, m_version);
+    m_request.headers.resize(m_header_spans.size() / 2);
+    for(size_t i = 0; i < m_request.headers.size(); i++)
+    {
+        m_request.headers[i].name = view(data, m_header_spans[2 * i]);
+        m_request.headers[i].value = view(data, m_header_spans[2 * i + 1]);
+    }
+    return HTTP_DONE;
+}
+
+bool HttpParser::parse_request_line(const char* data, size_t begin, size_t end)
+{
+    /* 方法 SP 请求目标 SP 版本，各部分之间只有一个空格 */
+    size_t sp1 = begin + scan_token(data + begin, end - begin);
+    if(sp1 == begin || sp1 == end || data[sp1] != ' ')
+        return false;
+
+    const char* p = static_cast<const char*>(memchr(data + sp1 + 1, ' ', end - sp1 - 1));
+    if(p == NULL)
+        return false;
+    size_t sp2 = p - data;
+    if(sp2 == sp1 + 1)
+        return false;
+
+    m_method = {begin, sp1 - begin};
+    m_uri = {sp1 + 1, sp2 - sp1 - 1};
+    m_version = {sp2 + 1, end - sp2 - 1};
+    /* HTTP/x.y */
+    return m_version.len == 8 && memcmp(data + m_version.off, "HTTP/", 5) == 0 &&
+        data[m_version.off + 6] == '.';
+}
+
+bool HttpParser::parse_header(const char* data, size_t begin, size_t end)
+{
+    if(m_header_spans.size() / 2 >= HTTP_MAX_HEADERS)
+        return false;
+
+    /* 名字紧跟冒号，不允许以空白开头的续行 */
+    size_t colon = begin + scan_token(data + begin, end - begin);
+    if(colon == begin || colon == end || data[colon] != ':')
+        return false;
+
+    size_t value = colon + 1;
+    while(value < end && (data[value] == ' ' || data[value] == '\t'))
+        value++;
+    size_t value_end = end;
+    while(value_end > value && (data[value_end - 1] == ' ' || data[value_end - 1] == '\t'))
+        value_end--;
+
+    m_header_spans.push_back({begin, colon - begin});
+    m_header_spans.push_back({value, value_end - value});
+    return true;
+}
@@ -0,0 +1,96 @@
+#ifndef __HTTPPARSER_H
+#define __HTTPPARSER_H
+
+#include <string_view>
+#include <vector>
+#include <stddef.h>
+
+/* 请求行和请求头一共最多的字节数、请求头最多的行数 */
+#define HTTP_MAX_REQUEST (64 * 1024)
+#define HTTP_MAX_HEADERS 100
+
+struct HttpHeader
+{
+    std::string_view name;
+    std::string_view value;
+};
+
+/* 解析出来的请求，各字段指向调用者的输入缓冲区，取走这个请求之前有效 */
+struct HttpRequest
+{
+    std::string_view method;
+    std::string_view uri;
+    std::string_view version;
+    std::vector<HttpHeader> headers;
+
+    /* 按名字查找请求头，不区分大小写，没有时返回空 */
+    std::string_view header(std::string_view name) const;
+    /* 有没有这个请求头，值为空也算有 */
+    bool has_header(std::string_view name) const;
+    /* HTTP/1.1默认保持连接，HTTP/1.0要明确要求，Connection头里的close、keep-alive优先 */
+    bool keep_alive() const;
+};
+
+/*
+ * 可以接着上次继续的HTTP请求解析器，直接在连接的输入缓冲区上解析，不拷贝数据
+ * 找行尾和检查字符用HttpScan.h中按CPU选择的SIMD扫描函数
+ * 每次传入从请求开头到目前收到的全部数据，已经解析过的行不再扫描；
+ * 缓冲区在两次调用之间可以搬动位置，内部只记偏移
+ * 完成时request()可用，length()是这个请求占的字节数，取走之后reset()再解析下一个
+ */
+class HttpParser
+{
+    public:
+        enum Result
+        {
+            /* 收到了完整的请求行和请求头 */
+            HTTP_DONE,
+            /* 还没有收到空行，等更多数据 */
+            HTTP_NEED_MORE,
+            /* 格式错误或者超过了长度限制，连接应当关闭 */
+            HTTP_BAD
+        };
+
+        HttpParser() { reset(); }
+
+        Result parse(const char* data, size_t len);
+        void reset();
+
+        const HttpRequest& request() const { return m_request; }
+        size_t length() const { return m_pos; }
+
+    private:
+        /* 一段数据在请求中的偏移和长度 */
+        struct Span
+        {
+            size_t off;
+            size_t len;
+        };
+
+        enum State
+        {
+            STATE_REQUEST_LINE,
+            STATE_HEADERS,
+            STATE_DONE
+        };
+
+        /* 解析一行，不包括行尾的\r\n，出错时返回false */
+        bool parse_request_line(const char* data, size_t begin, size_t end);
+        bool parse_header(const char* data, size_t begin, size_t end);
+        std::string_view view(const char* data, const Span& span) const
+        {
+            return std::string_view(data + span.off, span.len);
+        }
+
+    private:
+        State m_state;
+        /* 下一行从这里开始，之前的都已经解析过 */
+        size_t m_pos;
+        Span m_method;
+        Span m_uri;
+        Span m_version;
+        std::vector<Span> m_header_spans;
+        HttpRequest m_request;
+};
+
+#endif
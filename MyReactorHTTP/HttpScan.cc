@@ -0,0 +1,268 @@
+#include "HttpScan.h"
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HTTP_SCAN_X86
+#endif
+
+
+/* token字符：字母、数字和!#$%&'*+-.^_`|~ */
+static bool g_token_table[256];
+/*
+ * SIMD按高低4位查表：低4位的表给出哪些高4位的组合是token字符，
+ * 高4位的表把高4位换成对应的位，0x80以上的字节对应0，两者相与不为0就是token字符
+ */
+static uint8_t g_token_lo[16];
+static uint8_t g_token_hi[16];
+
+static void init_token_tables()
+{
+    const char* specials = "!#$%&'*+-.^_`|~";
+    for(int c = 0; c < 256; c++)
+        g_token_table[c] = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+    for(const char* s = specials; *s != '\0'; s++)
+        g_token_table[(unsigned char)*s] = true;
+
+    for(int c = 0; c < 128; c++)
+    {
+        if(g_token_table[c])
+            g_token_lo[c & 0x0f] |= (uint8_t)(1 << (c >> 4));
+    }
+    for(int h = 0; h < 8; h++)
+        g_token_hi[h] = (uint8_t)(1 << h);
+}
+
+static inline bool is_ctl(unsigned char c)
+{
+    return (c < 0x20 && c != '\t') || c == 0x7f;
+}
+
+static size_t scan_token_scalar(const char* p, size_t n)
+{
+    size_t i = 0;
+    while(i < n && g_token_table[(unsigned char)p[i]])
+        i++;
+    return i;
+}
+
+static size_t scan_text_scalar(const char* p, size_t n)
+{
+    size_t i = 0;
+    while(i < n && !is_ctl((unsigned char)p[i]))
+        i++;
+    return i;
+}
+
+
+#ifdef HTTP_SCAN_X86
+/*
+ * 16字节一块的判断写成总是内联的函数，内联进AVX2的函数后按VEX编码生成，
+ * 避免在256位指令之后执行传统SSE指令的状态切换开销
+ * 返回的掩码中第k位为1表示第k个字节命中
+ */
+__attribute__((target("sse4.2"), always_inline))
+static inline uint32_t non_token_mask16(const char* p)
+{
+    const __m128i lo_table = _mm_loadu_si128((const __m128i*)g_token_lo);
+    const __m128i hi_table = _mm_loadu_si128((const __m128i*)g_token_hi);
+    const __m128i low_mask = _mm_set1_epi8(0x0f);
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i lo = _mm_shuffle_epi8(lo_table, _mm_and_si128(v, low_mask));
+    /* 没有按字节的移位，按16位移完再去掉从相邻字节移进来的位 */
+    __m128i hi = _mm_shuffle_epi8(hi_table, _mm_and_si128(_mm_srli_epi16(v, 4), low_mask));
+    __m128i bad = _mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128());
+    return (uint32_t)_mm_movemask_epi8(bad);
+}
+
+__attribute__((target("sse4.2"), always_inline))
+static inline uint32_t ctl_mask16(const char* p)
+{
+    /* c <= 0x1f且不是\t，或者c == 0x7f */
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i ctl = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1f)), v);
+    ctl = _mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')), ctl);
+    __m128i bad = _mm_or_si128(ctl, _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7f)));
+    return (uint32_t)_mm_movemask_epi8(bad);
+}
+
+/*
+ * 整块扫完之后剩下的不足16字节：n不小于16时把最后16字节作为一块重新判断，
+ * 去掉已经检查过的部分；更短的逐字节判断
+ */
+#define SCAN_TAIL16(mask16, scalar, p, i, n) \
+    do \
+    { \
+        if((i) >= (n)) \
+            return (n); \
+        if((n) < 16) \
+            return (i) + scalar((p) + (i), (n) - (i)); \
+        uint32_t tail = mask16((p) + (n) - 16) & (0xffffu << ((i) - ((n) - 16))); \
+        return tail != 0 ? (n) - 16 + __builtin_ctz(tail) : (n); \
+    } while(0)
+
+__attribute__((target("sse4.2")))
+static size_t scan_token_sse42(const char* p, size_t n)
+{
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        uint32_t mask = non_token_mask16(p + i);
+        if(mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    SCAN_TAIL16(non_token_mask16, scan_token_scalar, p, i, n);
+}
+
+__attribute__((target("sse4.2")))
+static size_t scan_text_sse42(const char* p, size_t n)
+{
+    /* pcmpestri按范围比较：0x00-0x08、0x0a-0x1f、0x7f */
+    const __m128i ranges = _mm_setr_epi8(0x00, 0x08, 0x0a, 0x1f, 0x7f, 0x7f, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        int idx = _mm_cmpestri(ranges, 6, v, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+        if(idx != 16)
+            return i + idx;
+    }
+    SCAN_TAIL16(ctl_mask16, scan_text_scalar, p, i, n);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_token_avx2(const char* p, size_t n)
+{
+    /* vpshufb在两个128位的半边里各自查表，表要复制两份 */
+    const __m256i lo_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)g_token_lo));
+    const __m256i hi_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)g_token_hi));
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+        __m256i lo = _mm256_shuffle_epi8(lo_table, _mm256_and_si256(v, low_mask));
+        __m256i hi = _mm256_shuffle_epi8(hi_table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask));
+        __m256i bad = _mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), zero);
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(bad);
+        if(mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    if(i + 16 <= n)
+    {
+        uint32_t mask = non_token_mask16(p + i);
+        if(mask != 0)
+            return i + __builtin_ctz(mask);
+        i += 16;
+    }
+    SCAN_TAIL16(non_token_mask16, scan_token_scalar, p, i, n);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_text_avx2(const char* p, size_t n)
+{
+    const __m256i ctl_max = _mm256_set1_epi8(0x1f);
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+        __m256i ctl = _mm256_cmpeq_epi8(_mm256_min_epu8(v, ctl_max), v);
+        ctl = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, tab), ctl);
+        __m256i bad = _mm256_or_si256(ctl, _mm256_cmpeq_epi8(v, del));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(bad);
+        if(mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    if(i + 16 <= n)
+    {
+        uint32_t mask = ctl_mask16(p + i);
+        if(mask != 0)
+            return i + __builtin_ctz(mask);
+        i += 16;
+    }
+    SCAN_TAIL16(ctl_mask16, scan_text_scalar, p, i, n);
+}
+#endif
+
+
+typedef size_t (*ScanFunc)(const char* p, size_t n);
+
+static ScanLevel g_level = SCAN_SCALAR;
+static ScanFunc g_scan_token = scan_token_scalar;
+static ScanFunc g_scan_text = scan_text_scalar;
+
+ScanLevel scan_best_level()
+{
+#ifdef HTTP_SCAN_X86
+    /* 静态初始化时也可能调用，先让CPUID的结果就绪 */
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        return SCAN_AVX2;
+    if(__builtin_cpu_supports("sse4.2"))
+        return SCAN_SSE42;
+#endif
+    return SCAN_SCALAR;
+}
+
+bool set_scan_level(ScanLevel level)
+{
+    if(level > scan_best_level())
+        return false;
+
+    g_level = level;
+    g_scan_token = scan_token_scalar;
+    g_scan_text = scan_text_scalar;
+#ifdef HTTP_SCAN_X86
+    if(level == SCAN_SSE42)
+    {
+        g_scan_token = scan_token_sse42;
+        g_scan_text = scan_text_sse42;
+    }
+    else if(level == SCAN_AVX2)
+    {
+        g_scan_token = scan_token_avx2;
+        g_scan_text = scan_text_avx2;
+    }
+#endif
+    return true;
+}
+
+static bool init_scan()
+{
+    init_token_tables();
+    return set_scan_level(scan_best_level());
+}
+
+/* 其他文件的静态初始化不会用到扫描函数 */
+static bool g_scan_ready = init_scan();
+
+ScanLevel scan_level()
+{
+    return g_level;
+}
+
+const char* scan_level_name(ScanLevel level)
+{
+    switch(level)
+    {
+        case SCAN_SSE42:
+            return "sse4.2";
+        case SCAN_AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+size_t scan_token(const char* p, size_t n)
+{
+    return g_scan_token(p, n);
+}
+
+size_t scan_text(const char* p, size_t n)
+{
+    return g_scan_text(p, n);
+}
@@ -0,0 +1,30 @@
+#ifndef __HTTPSCAN_H
+#define __HTTPSCAN_H
+
+#include <stddef.h>
+
+/*
+ * HTTP解析器的扫描函数，启动时按CPUID选AVX2、SSE4.2或者逐字节的实现，
+ * 只读取[p, p + n)内的字节，结果和逐字节的实现完全相同
+ */
+
+/* 返回第一个不是token字符（RFC 7230，方法名和头部名字用的字符）的下标，都是时返回n */
+size_t scan_token(const char* p, size_t n);
+/* 返回第一个控制字符（小于0x20的字节中除了\t，以及0x7f）的下标，都不是时返回n；行尾的\r、\n就是控制字符 */
+size_t scan_text(const char* p, size_t n);
+
+enum ScanLevel
+{
+    SCAN_SCALAR,
+    SCAN_SSE42,
+    SCAN_AVX2
+};
+
+/* 这台机器支持的最好的一级 */
+ScanLevel scan_best_level();
+/* 改用指定的一级，超过scan_best_level()时返回false；用于比较，不是线程安全的 */
+bool set_scan_level(ScanLevel level);
+ScanLevel scan_level();
+const char* scan_level_name(ScanLevel level);
+
+#endif
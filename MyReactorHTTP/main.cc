@@ -1,8 +1,9 @@
 #include "MyReactor.h"
+#include "HttpHandler.h"
 #include "simple_log.h"
 #include "simple_config.h"
 
-MyReactor g_reactor;
+MyReactor<HttpHandler> g_reactor;
 
 
 void prog_exit(int signo)
@@ -12,6 +13,11 @@ void prog_exit(int signo)
     g_reactor.uninit();
 }
 
+void stats_dump(int signo)
+{
+    g_reactor.request_stats_dump();
+}
+
 void daemon_run()
 {
     int pid;
@@ -63,20 +69,64 @@ int main(int argc, char* argv[])
     signal(SIGINT, prog_exit);
     signal(SIGKILL, prog_exit);
     signal(SIGTERM, prog_exit);
+    /* kill -USR2输出各线程的统计，SIGUSR1已经用来重新加载日志配置 */
+    signal(SIGUSR2, stats_dump);
 
     short port = 0;
     int ch;
+    /* -p的TCP端口之外再监听的地址，比如unix:/tmp/server.sock、unix:@server、[::1]:12345，后面可以加“,latency”选用socket选项组 */
+    std::vector<std::string> endpoints;
     bool bdaemon = false;
-    while ((ch = getopt(argc, argv, "p:d")) != -1)
+    int mode = MODE_WORKER_QUEUE;
+    int idle_timeout = 60;
+    /* 线程数和CPU绑定，没有配置文件时按在线CPU数起工作线程，不绑定 */
+    g_reactor.load_config("./conf/reactor.conf");
+    /* 保持连接的请求数上限和空闲时间 */
+    if (g_reactor.handler().load_config("./conf/http.conf"))
+        idle_timeout = g_reactor.handler().keepalive_timeout();
+
+    while ((ch = getopt(argc, argv, "p:dsrub:i:l:L:w:")) != -1)
     {
         switch (ch)
         {
             case 'd':
                 bdaemon = true;
                 break;
+            case 's':
+                /* one loop per thread */
+                mode = MODE_SUB_REACTOR;
+                break;
+            case 'r':
+                /* 每个子反应堆一个SO_REUSEPORT监听socket */
+                mode = MODE_REUSEPORT;
+                break;
+            case 'u':
+                /* 每个子反应堆一个io_uring，收发都是完成事件 */
+                mode = MODE_URING;
+                break;
             case 'p':
                 port = atol(optarg);
                 break;
+            case 'L':
+                /* 可以给多次，同机的客户走unix socket不经过TCP协议栈 */
+                endpoints.push_back(optarg);
+                break;
+            case 'b':
+                /* listen的backlog，默认SOMAXCONN */
+                g_reactor.set_backlog(atoi(optarg));
+                break;
+            case 'i':
+                /* 空闲连接的超时秒数，0表示不限制 */
+                idle_timeout = atoi(optarg);
+                break;
+            case 'l':
+                /* 低延迟：忙等的微秒数，覆盖配置文件中的busy_poll_us */
+                g_reactor.set_busy_poll(atoi(optarg));
+                break;
+            case 'w':
+                /* 工作线程（子反应堆）的个数，覆盖配置文件中的worker_threads */
+                g_reactor.set_thread_num(atoi(optarg));
+                break;
         }
     }
 
@@ -87,7 +137,9 @@ int main(int argc, char* argv[])
     if (port == 0)
         port = 12345;
 
-    if (!g_reactor.init("0.0.0.0", 12345))
+    g_reactor.set_idle_timeout(idle_timeout);
+    endpoints.insert(endpoints.begin(), Endpoint::inet("0.0.0.0", port));
+    if (!g_reactor.init(endpoints, mode))
         return -1;
 
 
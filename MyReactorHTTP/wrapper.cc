@@ -1,125 +1,45 @@
 #include "wrapper.h"
 
 
-/*
- * clienterror - returns an error message to the client
- */
-void clienterror(int fd, char *cause, char *errnum, const char *shortmsg, const char *longmsg)
-{
-    char buf[MAXLINE], body[MAXBUF];
-
-    /* Build the HTTP response body */
-    sprintf(body, "<html><title>Tiny Error</title>");
-    sprintf(body, "%s<body bgcolor=""ffffff"">\r\n", body);
-    sprintf(body, "%s%s: %s\r\n", body, errnum, shortmsg);
-    sprintf(body, "%s<p>%s: %s\r\n", body, longmsg, cause);
-    sprintf(body, "%s<hr><em>The Tiny Web server</em>\r\n", body);
-
-    /* Print the HTTP response */
-    sprintf(buf, "HTTP/1.0 %s %s\r\n", errnum, shortmsg);
-    Rio_writen(fd, buf, strlen(buf));
-    sprintf(buf, "Content-type: text/html\r\n");
-    Rio_writen(fd, buf, strlen(buf));
-    sprintf(buf, "Content-length: %d\r\n\r\n", (int)strlen(body));
-    Rio_writen(fd, buf, strlen(buf));
-    Rio_writen(fd, body, strlen(body));
-}
-
+static std::function<std::string()> g_stats_provider;
+static long g_sendfile_threshold = SENDFILE_THRESHOLD;
+static FileCache g_file_cache;
 
 
 /*
- * rio_readinitb - Associate a descriptor with a read buffer and reset buffer
+ * response_head - status line and the headers every response carries
  */
-void rio_readinitb(rio_t *rp, int fd)
+static void response_head(std::string *out, const char *status, int keep_alive)
 {
-    rp->rio_fd = fd;
-    rp->rio_cnt = 0;
-    rp->rio_bufptr = rp->rio_buf;
+    out->append("HTTP/1.1 ");
+    out->append(status);
+    out->append("\r\nServer: Tiny Web Server\r\n");
+    out->append(keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n");
 }
 
-void Rio_readinitb(rio_t *rp, int fd)
-{
-    rio_readinitb(rp, fd);
-}
-
-
-static ssize_t rio_read(rio_t *rp, char *usrbuf, size_t n)
-{
-    int cnt;
-
-    while (rp->rio_cnt <= 0) {  /* refill if buf is empty */
-        rp->rio_cnt = read(rp->rio_fd, rp->rio_buf,
-                sizeof(rp->rio_buf));
-        if (rp->rio_cnt < 0) {
-            if (errno != EINTR) /* interrupted by sig handler return */
-                return -1;
-        }
-        else if (rp->rio_cnt == 0)  /* EOF */
-            return 0;
-        else
-            rp->rio_bufptr = rp->rio_buf; /* reset buffer ptr */
-    }
-
-    /* Copy min(n, rp->rio_cnt) bytes from internal buf to user buf */
-    cnt = n;
-    if (rp->rio_cnt < static_cast<ssize_t>(n))
-        cnt = rp->rio_cnt;
-    memcpy(usrbuf, rp->rio_bufptr, cnt);
-    rp->rio_bufptr += cnt;
-    rp->rio_cnt -= cnt;
-    return cnt;
-}
-
-
 /*
- * rio_readlineb - robustly read a text line (buffered)
+ * clienterror - returns an error message to the client
  */
-ssize_t rio_readlineb(rio_t *rp, void *usrbuf, size_t maxlen)
+void clienterror(std::string *out, int keep_alive, const char *cause, const char *errnum, const char *shortmsg, const char *longmsg)
 {
-    size_t n, rc;
-    char c, *bufp = static_cast<char*>(usrbuf);
-
-    for (n = 1; n < maxlen; n++) {
-        if ((rc = rio_read(rp, &c, 1)) == 1) {
-            *bufp++ = c;
-            if (c == '\n')
-                break;
-        } else if (rc == 0) {
-            if (n == 1)
-                return 0; /* EOF, no data read */
-            else
-                break;    /* EOF, some data was read */
-        } else
-            return -1;	  /* error */
-    }
-    *bufp = 0;
-    return n;
-}
+    char buf[MAXLINE];
 
-ssize_t Rio_readlineb(rio_t *rp, void *usrbuf, size_t maxlen)
-{
-    ssize_t rc;
+    /* Build the HTTP response body */
+    std::string body = "<html><title>Tiny Error</title>";
+    body += "<body bgcolor=""ffffff"">\r\n";
+    body.append(errnum).append(": ").append(shortmsg).append("\r\n");
+    body.append("<p>").append(longmsg).append(": ").append(cause).append("\r\n");
+    body += "<hr><em>The Tiny Web server</em>\r\n";
 
-    if ((rc = rio_readlineb(rp, usrbuf, maxlen)) < 0)
-        unix_error("Rio_readlineb error");
-    return rc;
+    /* Print the HTTP response */
+    snprintf(buf, sizeof(buf), "%s %s", errnum, shortmsg);
+    response_head(out, buf, keep_alive);
+    out->append("Content-type: text/html\r\n");
+    snprintf(buf, sizeof(buf), "Content-length: %zu\r\n\r\n", body.size());
+    out->append(buf);
+    out->append(body);
 }
 
-/*
- * read_requesthdrs - read and parse HTTP request headers
- */
-void read_requesthdrs(rio_t *rp)
-{
-    char buf[MAXLINE];
-
-    Rio_readlineb(rp, buf, MAXLINE);
-    printf("%s", buf);
-    while(strcmp(buf, "\r\n")) {
-        Rio_readlineb(rp, buf, MAXLINE);
-        printf("%s", buf);
-    }
-    return;
-}
 
 
 /*
@@ -155,24 +75,58 @@ int parse_uri(char *uri, char *filename, char *cgiargs)
 
 /*
  * serve_dynamic - run a CGI program on behalf of the client
+ *                 fork和等待子进程会阻塞，调用者在submit()的任务里运行它
  */
-void serve_dynamic(int fd, char *filename, char *cgiargs)
+void serve_dynamic(std::string *out, const char *filename, const char *cgiargs)
 {
     char buf[MAXLINE], *emptylist[] = { NULL };
+    int fds[2];
+    pid_t pid;
 
-    /* Return first part of HTTP response */
-    sprintf(buf, "HTTP/1.0 200 OK\r\n");
-    Rio_writen(fd, buf, strlen(buf));
-    sprintf(buf, "Server: Tiny Web Server\r\n");
-    Rio_writen(fd, buf, strlen(buf));
-
-    if (Fork() == 0) { /* child */
-        /* Real server would set all CGI vars here */
-        setenv("QUERY_STRING", cgiargs, 1);
-        Dup2(fd, STDOUT_FILENO);         /* Redirect stdout to client */
-        Execve(filename, emptylist, environ); /* Run CGI program */
+    /* 子进程里只能做异步信号安全的事，环境变量在fork之前准备好 */
+    std::string query = std::string("QUERY_STRING=") + cgiargs;
+    std::vector<char *> envp;
+    for (char **env = environ; *env != NULL; env++)
+        if (strncmp(*env, "QUERY_STRING=", 13))
+            envp.push_back(*env);
+    envp.push_back(&query[0]);
+    envp.push_back(NULL);
+
+    /* 其他线程同时fork出的子进程不能继承管道，否则读端等不到EOF */
+    if (pipe2(fds, O_CLOEXEC) < 0) {
+        clienterror(out, 0, filename, "500", "Internal Server Error",
+                "Tiny couldn't run the CGI program");
+        return;
+    }
+    if ((pid = fork()) < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        clienterror(out, 0, filename, "500", "Internal Server Error",
+                "Tiny couldn't run the CGI program");
+        return;
     }
-    Wait(NULL); /* Parent waits for and reaps child */
+    if (pid == 0) { /* child */
+        /* Redirect stdout to the pipe，dup2出来的fd不带O_CLOEXEC */
+        if (dup2(fds[1], STDOUT_FILENO) >= 0)
+            execve(filename, emptylist, &envp[0]); /* Run CGI program */
+        _exit(127);
+    }
+    close(fds[1]);
+
+    /* Return first part of HTTP response，CGI的输出没有长度，只能以关闭连接结束 */
+    response_head(out, "200 OK", 0);
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) != 0) {
+        if (n < 0 && errno != EINTR)
+            break;
+        if (n > 0)
+            out->append(buf, n);
+    }
+    close(fds[0]);
+
+    /* 只回收自己的子进程；-d时SIGCHLD被忽略，子进程已经自动回收，返回ECHILD */
+    while (waitpid(pid, NULL, 0) < 0 && errno == EINTR)
+        ;
 }
 
 /*
@@ -197,36 +151,6 @@ void get_filetype(char *filename, char *filetype)
 }
 
 
-int Rio_writen(int fd, void *usrbuf, size_t n)
-{
-    if (rio_writen(fd, usrbuf, n) != static_cast<ssize_t>(n))
-        /* unix_error("Rio_writen error"); */
-        return -1;
-    return 0;
-}
-
-/*
- * rio_writen - robustly write n bytes (unbuffered)
- */
-ssize_t rio_writen(int fd, void *usrbuf, size_t n)
-{
-    size_t nleft = n;
-    ssize_t nwritten;
-    char *bufp = static_cast<char*>(usrbuf);
-
-    while (nleft > 0) {
-        if ((nwritten = write(fd, bufp, nleft)) <= 0) {
-            if (errno == EINTR)  /* interrupted by sig handler return */
-                nwritten = 0;    /* and call write() again */
-            else
-                return -1;       /* errorno set by write() */
-        }
-        nleft -= nwritten;
-        bufp += nwritten;
-    }
-    return n;
-}
-
 void unix_error(const char *msg) /* unix-style error */
 {
     fprintf(stderr, "%s: %s\n", msg, strerror(errno));
@@ -259,129 +183,175 @@ void Munmap(void *start, size_t length)
 
 
 
-void Close(int fd)
+/*
+ * serve_static - copy a file back to the client
+ */
+int serve_static(std::string *out, int keep_alive, char *filename, const CachedFile &cf, HttpFile *file)
 {
-    int rc;
+    int srcfd = -1;
+    char *srcp, buf[MAXLINE];
+
+    /* 大文件复制一份缓存着的fd（带FD_CLOEXEC），正文由调用者sendfile；失败时回复403而不是退出 */
+    if (!cf.in_memory() && g_sendfile_threshold > 0 && cf.size >= (size_t)g_sendfile_threshold) {
+        srcfd = fcntl(cf.fd, F_DUPFD_CLOEXEC, 0);
+        g_file_cache.add_syscalls(cf, 1);
+        if (srcfd < 0) {
+            clienterror(out, keep_alive, filename, "403", "Forbidden",
+                    "Tiny couldn't read the file");
+            return 0;
+        }
+    }
+
+    /* Send response headers to client */
+    response_head(out, "200 OK", keep_alive);
+    snprintf(buf, sizeof(buf), "Content-length: %zu\r\n", cf.size);
+    out->append(buf);
+    out->append("Content-type: ");
+    out->append(cf.filetype);
+    out->append("\r\n\r\n");
+
+    if (srcfd >= 0) {
+        file->fd = srcfd;
+        file->size = cf.size;
+        return 0;
+    }
 
-    if ((rc = close(fd)) < 0)
-        unix_error("Close error");
+    /* Send response body to client */
+    if (cf.in_memory()) {
+        out->append(cf.data);
+        return 0;
+    }
+    if (cf.size == 0)
+        return 0;
+    srcp = static_cast<char*>(Mmap(0, cf.size, PROT_READ, MAP_PRIVATE, cf.fd, 0));
+    out->append(srcp, cf.size);
+    Munmap(srcp, cf.size);
+    g_file_cache.add_syscalls(cf, 2);
+
+    return 0;
 }
 
 
-pid_t Fork(void)
-{
-    pid_t pid;
 
-    if ((pid = fork()) < 0)
-        unix_error("Fork error");
-    return pid;
+void set_sendfile_threshold(long threshold)
+{
+    g_sendfile_threshold = threshold;
 }
 
-int Dup2(int fd1, int fd2)
+void set_file_cache(size_t max_entries, size_t max_bytes, int ttl_ms)
 {
-    int rc;
-
-    if ((rc = dup2(fd1, fd2)) < 0)
-        unix_error("Dup2 error");
-    return rc;
+    g_file_cache.configure(max_entries, max_bytes, ttl_ms);
 }
 
-
-void Execve(const char *filename, char *const argv[], char *const envp[])
+std::string file_cache_json()
 {
-    if (execve(filename, argv, envp) < 0)
-        unix_error("Execve error");
+    return g_file_cache.to_json();
 }
 
-pid_t Wait(int *status)
+void set_stats_provider(const std::function<std::string()>& provider)
 {
-    pid_t pid;
-
-    if ((pid  = wait(status)) < 0)
-        unix_error("Wait error");
-    return pid;
+    g_stats_provider = provider;
 }
 
 /*
- * serve_static - copy a file back to the client
+ * serve_stats - return the reactor counters as JSON
  */
-int serve_static(int fd, char *filename, int filesize)
+void serve_stats(std::string *out, int keep_alive)
 {
-    int srcfd;
-    char *srcp, filetype[MAXLINE], buf[MAXBUF];
-
-    /* Send response headers to client */
-    get_filetype(filename, filetype);
-    sprintf(buf, "HTTP/1.0 200 OK\r\n");
-    sprintf(buf, "%sServer: Tiny Web Server\r\n", buf);
-    sprintf(buf, "%sContent-length: %d\r\n", buf, filesize);
-    sprintf(buf, "%sContent-type: %s\r\n\r\n", buf, filetype);
-    int ret = Rio_writen(fd, buf, strlen(buf));
-    if(ret == -1)
-        return -1;
-
-    /* Send response body to client */
-    srcfd = Open(filename, O_RDONLY, 0);
-    srcp = static_cast<char*>(Mmap(0, filesize, PROT_READ, MAP_PRIVATE, srcfd, 0));
-    Close(srcfd);
-    Rio_writen(fd, srcp, filesize);
-    Munmap(srcp, filesize);
+    std::string body = g_stats_provider();
+    char buf[MAXLINE];
 
-    return 0;
+    response_head(out, "200 OK", keep_alive);
+    snprintf(buf, sizeof(buf), "Content-length: %zu\r\n", body.size());
+    out->append(buf);
+    out->append("Content-type: application/json\r\n\r\n");
+    out->append(body);
 }
 
 
-
 /*
  * doit - handle one HTTP request/response transaction
  */
-int doit(int fd)
+int doit(const HttpRequest &req, std::string *out, int *keep_alive, HttpFile *file, HttpCgi *cgi)
 {
     int is_static;
     struct stat sbuf;
-    char buf[MAXLINE], method[MAXLINE], uri[MAXLINE], version[MAXLINE];
+    char method[MAXLINE], uri[MAXLINE];
     char filename[MAXLINE], cgiargs[MAXLINE];
-    rio_t rio;
-
-    /* Read request line and headers */
-    Rio_readinitb(&rio, fd);
-    Rio_readlineb(&rio, buf, MAXLINE);
-    sscanf(buf, "%s %s %s", method, uri, version);
-    printf("method = %s\n",method);
-    printf("uri = %s\n",uri);
-    printf("version = %s\n",version);
+
+    file->fd = -1;
+    cgi->filename.clear();
+
+    /* parse_uri要改写uri，方法和uri复制出来；放不下的回复错误并关闭 */
+    if (req.uri.size() >= MAXLINE) {
+        *keep_alive = 0;
+        clienterror(out, 0, "request", "414", "URI Too Long",
+                "Tiny couldn't handle the request URI");
+        return 0;
+    }
+    if (req.method.size() >= MAXLINE) {
+        *keep_alive = 0;
+        clienterror(out, 0, "request", "400", "Bad Request",
+                "Tiny couldn't parse the request method");
+        return 0;
+    }
+    memcpy(method, req.method.data(), req.method.size());
+    method[req.method.size()] = '\0';
+    memcpy(uri, req.uri.data(), req.uri.size());
+    uri[req.uri.size()] = '\0';
+    /* 调用者不允许时一律关闭 */
+    *keep_alive = *keep_alive && req.keep_alive();
+    /* 不读请求体，带请求体的请求之后无法分帧，否则请求体会被当成下一个请求，回复之后关闭 */
+    if (req.has_header("Content-Length") || req.has_header("Transfer-Encoding"))
+        *keep_alive = 0;
+
     if (strcasecmp(method, "GET")) {
-        clienterror(fd, method, "501", "Not Implemented",
+        /* 不读请求体，后面的数据无法分帧，回复之后关闭 */
+        *keep_alive = 0;
+        clienterror(out, 0, method, "501", "Not Implemented",
                 "Tiny does not implement this method");
         return 0;
     }
-    read_requesthdrs(&rio);
 
-    /* Parse URI from GET request */
-    is_static = parse_uri(uri, filename, cgiargs);
-    if (stat(filename, &sbuf) < 0) {
-        clienterror(fd, filename, "404", "Not found",
-                "Tiny couldn't find this file");
+    if (!strcmp(uri, "/__stats") && g_stats_provider) {
+        serve_stats(out, *keep_alive);
         return 0;
     }
 
+    /* Parse URI from GET request */
+    is_static = parse_uri(uri, filename, cgiargs);
+
     if (is_static) { /* Serve static content */
-        if (!(S_ISREG(sbuf.st_mode)) || !(S_IRUSR & sbuf.st_mode)) {
-            clienterror(fd, filename, "403", "Forbidden",
+        /* 比sendfile的门槛小的文件缓存内容，门槛为0时按默认大小分 */
+        CachedFilePtr cf;
+        int err = g_file_cache.lookup(filename,
+                g_sendfile_threshold > 0 ? g_sendfile_threshold : SENDFILE_THRESHOLD, &cf);
+        if (err == ENOENT) {
+            clienterror(out, *keep_alive, filename, "404", "Not found",
+                    "Tiny couldn't find this file");
+            return 0;
+        }
+        if (err != 0) {
+            clienterror(out, *keep_alive, filename, "403", "Forbidden",
                     "Tiny couldn't read the file");
             return 0;
         }
-        int ret = serve_static(fd, filename, sbuf.st_size);
-        if(ret == -1)
-            return -1;
+        serve_static(out, *keep_alive, filename, *cf, file);
     }
     else { /* Serve dynamic content */
+        if (stat(filename, &sbuf) < 0) {
+            clienterror(out, *keep_alive, filename, "404", "Not found",
+                    "Tiny couldn't find this file");
+            return 0;
+        }
         if (!(S_ISREG(sbuf.st_mode)) || !(S_IXUSR & sbuf.st_mode)) {
-            clienterror(fd, filename, "403", "Forbidden",
+            clienterror(out, *keep_alive, filename, "403", "Forbidden",
                     "Tiny couldn't run the CGI program");
             return 0;
         }
-        serve_dynamic(fd, filename, cgiargs);
+        *keep_alive = 0;
+        cgi->filename = filename;
+        cgi->cgiargs = cgiargs;
     }
 
     return 0;
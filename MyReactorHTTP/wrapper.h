@@ -22,6 +22,11 @@
 #include <netdb.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <string>
+#include <vector>
+#include <functional>
+#include "HttpParser.h"
+#include "FileCache.h"
 
 
 /* Default file permissions are DEF_MODE & ~DEF_UMASK */
@@ -31,15 +36,6 @@
 /* Simplifies calls to bind(), connect(), and accept() */
 typedef struct sockaddr SA;
 
-/* Persistent state for the robust I/O (Rio) package */
-#define RIO_BUFSIZE 8192
-typedef struct {
-    int rio_fd;                /* descriptor for this internal buf */
-    int rio_cnt;               /* unread bytes in internal buf */
-    char *rio_bufptr;          /* next unread byte in internal buf */
-    char rio_buf[RIO_BUFSIZE]; /* internal buffer */
-} rio_t;
-
 /* External variables */
 extern int h_errno;    /* defined by BIND for DNS errors */
 extern char **environ; /* defined by libc */
@@ -135,20 +131,6 @@ void Sem_init(sem_t *sem, int pshared, unsigned int value);
 void P(sem_t *sem);
 void V(sem_t *sem);
 
-/* Rio (Robust I/O) package */
-ssize_t rio_readn(int fd, void *usrbuf, size_t n);
-ssize_t rio_writen(int fd, void *usrbuf, size_t n);
-void rio_readinitb(rio_t *rp, int fd);
-ssize_t	rio_readnb(rio_t *rp, void *usrbuf, size_t n);
-ssize_t	rio_readlineb(rio_t *rp, void *usrbuf, size_t maxlen);
-
-/* Wrappers for Rio package */
-ssize_t Rio_readn(int fd, void *usrbuf, size_t n);
-int Rio_writen(int fd, void *usrbuf, size_t n);
-void Rio_readinitb(rio_t *rp, int fd);
-ssize_t Rio_readnb(rio_t *rp, void *usrbuf, size_t n);
-ssize_t Rio_readlineb(rio_t *rp, void *usrbuf, size_t maxlen);
-
 /* Client/server helper functions */
 int open_clientfd(char *hostname, int portno);
 int open_listenfd(int portno);
@@ -158,12 +140,48 @@ int Open_clientfd(char *hostname, int port);
 int Open_listenfd(int port);
 
 
-int doit(int fd);
-void read_requesthdrs(rio_t *rp);
+/* 不小于这个大小的静态文件不读进内存，交给连接用sendfile从文件直接发送 */
+#define SENDFILE_THRESHOLD (32 * 1024)
+/* 改用sendfile的文件大小，0表示一律读进内存 */
+void set_sendfile_threshold(long threshold);
+
+/* 静态文件缓存的条目数、内容的字节数上限和重新检查的间隔，条目数为0时不缓存 */
+void set_file_cache(size_t max_entries, size_t max_bytes, int ttl_ms);
+/* 缓存的命中率和每个静态请求的文件系统调用数，放进GET /__stats的输出 */
+std::string file_cache_json();
+
+/* 留给调用者发送的文件正文，紧跟在out之后；fd为-1表示回复都在out里 */
+struct HttpFile
+{
+    int fd;
+    size_t size;
+};
+
+/* 留给调用者在工作线程上运行的CGI程序，filename为空表示没有 */
+struct HttpCgi
+{
+    std::string filename;
+    std::string cgiargs;
+};
+
+/*
+ * 处理一个解析好的请求，回复追加到out，由调用者发送
+ * 请求无法处理时返回-1，调用者应当关闭连接
+ * keep_alive传入时表示是否还允许保持连接，返回时是回复之后是否保持连接
+ * 大文件的正文不放进out，打开的文件通过file返回，由调用者发送和关闭
+ * CGI请求不在这里运行，程序和参数通过cgi返回，调用者用serve_dynamic生成回复，回复之后关闭
+ */
+int doit(const HttpRequest &req, std::string *out, int *keep_alive, HttpFile *file, HttpCgi *cgi);
 int parse_uri(char *uri, char *filename, char *cgiargs);
-int serve_static(int fd, char *filename, int filesize);
+/* 回复都是HTTP/1.1，keep_alive决定Connection头 */
+int serve_static(std::string *out, int keep_alive, char *filename, const CachedFile &cf, HttpFile *file);
 void get_filetype(char *filename, char *filetype);
-void serve_dynamic(int fd, char *filename, char *cgiargs);
-void clienterror(int fd, char *cause, char *errnum, const char *shortmsg, const char *longmsg);
+/* 运行CGI程序，回复追加到out；会阻塞到程序退出 */
+void serve_dynamic(std::string *out, const char *filename, const char *cgiargs);
+void clienterror(std::string *out, int keep_alive, const char *cause, const char *errnum, const char *shortmsg, const char *longmsg);
+
+/* GET /__stats返回provider生成的JSON，没有设置时按普通文件处理 */
+void set_stats_provider(const std::function<std::string()>& provider);
+void serve_stats(std::string *out, int keep_alive);
 
 #endif
@@ -0,0 +1,104 @@
+/*
+ * connect洪水测试：多个线程不停地connect/close，统计服务器每秒接受的连接数
+ * 用法：./bench_accept [-h ip] [-p port] [-t 线程数] [-s 秒数]
+ */
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static struct sockaddr_in g_servaddr;
+static volatile bool g_stop = false;
+static std::atomic<long> g_connected(0);
+static std::atomic<long> g_failed(0);
+
+static double now_sec()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+void* flood_proc(void* args)
+{
+    long ok = 0, fail = 0;
+    while(!g_stop)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if(fd == -1)
+        {
+            fail++;
+            continue;
+        }
+
+        /* 立即发RST关闭，避免客户端堆积TIME_WAIT耗尽端口 */
+        struct linger lg = {1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+
+        if(connect(fd, (struct sockaddr*)&g_servaddr, sizeof(g_servaddr)) == 0)
+            ok++;
+        else
+            fail++;
+        close(fd);
+    }
+
+    g_connected += ok;
+    g_failed += fail;
+    return NULL;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* ip = "127.0.0.1";
+    int port = 12345;
+    int nthreads = 8;
+    int seconds = 5;
+
+    int ch;
+    while((ch = getopt(argc, argv, "h:p:t:s:")) != -1)
+    {
+        switch(ch)
+        {
+            case 'h':
+                ip = optarg;
+                break;
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 't':
+                nthreads = atoi(optarg);
+                break;
+            case 's':
+                seconds = atoi(optarg);
+                break;
+        }
+    }
+
+    memset(&g_servaddr, 0, sizeof(g_servaddr));
+    g_servaddr.sin_family = AF_INET;
+    g_servaddr.sin_addr.s_addr = inet_addr(ip);
+    g_servaddr.sin_port = htons(port);
+
+    std::vector<pthread_t> threads(nthreads);
+    double start = now_sec();
+    for(int i = 0; i < nthreads; i++)
+        pthread_create(&threads[i], NULL, flood_proc, NULL);
+
+    sleep(seconds);
+    g_stop = true;
+    for(int i = 0; i < nthreads; i++)
+        pthread_join(threads[i], NULL);
+    double elapsed = now_sec() - start;
+
+    printf("threads=%d seconds=%.2f connected=%ld failed=%ld accepts/sec=%.0f\n",
+            nthreads, elapsed, g_connected.load(), g_failed.load(), g_connected / elapsed);
+    return 0;
+}
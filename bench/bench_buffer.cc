@@ -0,0 +1,149 @@
+/*
+ * 比较原来handle_client中memset + recv(256) + std::string +=的读循环
+ * 与Buffer::read_fd（readv + 64KB栈上缓冲区）读取同样数据时的系统调用次数和吞吐
+ * 写线程通过socketpair不断发送定长消息，读线程poll到可读后一直读到EAGAIN
+ * 用法：./bench_buffer [每种大小的总字节数]
+ */
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+
+#include "../reactor/Buffer.h"
+
+static double now_sec()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+struct WriterArg
+{
+    int fd;
+    size_t msg_size;
+    long count;
+};
+
+void* writer_proc(void* args)
+{
+    WriterArg* arg = static_cast<WriterArg*>(args);
+    std::string msg(arg->msg_size, 'x');
+    for(long i = 0; i < arg->count; i++)
+    {
+        size_t off = 0;
+        while(off < msg.size())
+        {
+            ssize_t n = write(arg->fd, msg.data() + off, msg.size() - off);
+            if(n <= 0)
+                return NULL;
+            off += n;
+        }
+    }
+    shutdown(arg->fd, SHUT_WR);
+    return NULL;
+}
+
+/* 原来的读法，返回读到的字节数，reads记录recv调用次数 */
+long read_old(int fd, long* reads)
+{
+    long total = 0;
+    bool eof = false;
+    while(!eof)
+    {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        poll(&pfd, 1, -1);
+
+        std::string strclientmsg;
+        char buff[256];
+        while(1)
+        {
+            memset(buff, 0, sizeof(buff));
+            int nRecv = recv(fd, buff, 256, 0);
+            (*reads)++;
+            if(nRecv <= 0)
+            {
+                eof = nRecv == 0;
+                break;
+            }
+            /* 原来的代码用strclientmsg += buff，遇到'\0'会截断，这里按长度追加 */
+            strclientmsg.append(buff, nRecv);
+        }
+        total += strclientmsg.size();
+    }
+    return total;
+}
+
+/* Connection::read_input的读法 */
+long read_buffer(int fd, long* reads)
+{
+    long total = 0;
+    bool eof = false;
+    Buffer buf;
+    while(!eof)
+    {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        poll(&pfd, 1, -1);
+
+        while(1)
+        {
+            int saved_errno = 0;
+            ssize_t n = buf.read_fd(fd, &saved_errno);
+            (*reads)++;
+            if(n <= 0)
+            {
+                eof = n == 0;
+                break;
+            }
+        }
+        total += buf.readable_bytes();
+        buf.retrieve_all();
+    }
+    return total;
+}
+
+void run(size_t msg_size, long total_bytes, bool use_buffer)
+{
+    int sv[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+
+    WriterArg arg;
+    arg.fd = sv[1];
+    arg.msg_size = msg_size;
+    arg.count = total_bytes / msg_size > 0 ? total_bytes / msg_size : 1;
+
+    pthread_t tid;
+    double start = now_sec();
+    pthread_create(&tid, NULL, writer_proc, &arg);
+    long reads = 0;
+    long got = use_buffer ? read_buffer(sv[0], &reads) : read_old(sv[0], &reads);
+    pthread_join(tid, NULL);
+    double elapsed = now_sec() - start;
+
+    printf("%10zu %-12s %14.2f %12.0f\n", msg_size, use_buffer ? "Buffer" : "recv(256)",
+            (double)reads / arg.count, got / elapsed / 1e6);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+int main(int argc, char* argv[])
+{
+    long total_bytes = argc > 1 ? atol(argv[1]) : 256L * 1024 * 1024;
+
+    printf("%10s %-12s %14s %12s\n", "msg bytes", "reader", "reads/msg", "MB/s");
+    size_t sizes[] = {256, 4096, 65536, 1048576};
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        run(sizes[i], total_bytes, false);
+        run(sizes[i], total_bytes, true);
+    }
+    return 0;
+}
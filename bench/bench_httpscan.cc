@@ -0,0 +1,113 @@
+/*
+ * 比较HttpParser用逐字节、SSE4.2和AVX2扫描时解析请求的速度
+ * 请求头由浏览器常见的头部拼成，请求行加请求头一共约200字节到4KB
+ * 每种大小分别用这台机器支持的各级扫描函数解析，输出每秒请求数和MB/s
+ * 用法：./bench_httpscan [每项的秒数]
+ */
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../MyReactorHTTP/HttpParser.h"
+#include "../MyReactorHTTP/HttpScan.h"
+
+static const char* g_headers[] = {
+    "Host: www.example.com\r\n",
+    "Connection: keep-alive\r\n",
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n",
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,image/apng,*/*;q=0.8\r\n",
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n",
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n",
+    "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n",
+    "Sec-Fetch-Site: same-origin\r\n",
+    "Sec-Fetch-Mode: navigate\r\n",
+    "Referer: http://www.example.com/home.html\r\n",
+    "If-None-Match: \"5f3c-61a2b7c8d9e0f\"\r\n",
+    "Cookie: _ga=GA1.2.1234567890.1700000000; session=7f3c2a9d0e4b4c8f9a1b2c3d4e5f6a7b; theme=dark; lang=zh-CN\r\n",
+    "X-Forwarded-For: 203.0.113.42, 198.51.100.7\r\n",
+    "X-Request-Id: 6b1f0c2e-8a7d-4e39-9c5b-2f4a1d3e7c90\r\n",
+};
+#define NHEADERS (sizeof(g_headers) / sizeof(g_headers[0]))
+
+static volatile size_t g_sink;
+
+static double now_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* 请求行加上轮流取的请求头，放不下的跳过，最后用一个X-Pad头补足size字节 */
+static std::string make_request(size_t size)
+{
+    std::string req = "GET /images/logo.png?v=20240514 HTTP/1.1\r\n";
+    for(size_t i = 0, skipped = 0; skipped < NHEADERS; i++)
+    {
+        const char* h = g_headers[i % NHEADERS];
+        if(req.size() + strlen(h) + 2 > size)
+        {
+            skipped++;
+            continue;
+        }
+        req += h;
+        skipped = 0;
+    }
+    /* "X-Pad: "加上行尾共9个字节 */
+    if(req.size() + 2 + 9 < size)
+        req += "X-Pad: " + std::string(size - req.size() - 2 - 9, 'a') + "\r\n";
+    return req + "\r\n";
+}
+
+/* 返回每秒解析的请求数 */
+static double run(const std::string& req, double seconds)
+{
+    HttpParser parser;
+    long requests = 0;
+    double start = now_sec();
+    double elapsed = 0;
+    do
+    {
+        for(int i = 0; i < 1000; i++)
+        {
+            if(parser.parse(req.data(), req.size()) != HttpParser::HTTP_DONE)
+            {
+                printf("request does not parse\n");
+                exit(1);
+            }
+            g_sink += parser.request().headers.size();
+            parser.reset();
+        }
+        requests += 1000;
+        elapsed = now_sec() - start;
+    } while(elapsed < seconds);
+    return requests / elapsed;
+}
+
+int main(int argc, char* argv[])
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 1;
+    const size_t sizes[] = {200, 512, 1024, 2048, 4096};
+    ScanLevel best = scan_best_level();
+
+    printf("best scan level on this CPU: %s\n", scan_level_name(best));
+    printf("%-8s %-8s %12s %10s %8s\n", "bytes", "scan", "req/s", "MB/s", "speedup");
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        std::string req = make_request(sizes[i]);
+        double scalar = 0;
+        for(int level = SCAN_SCALAR; level <= best; level++)
+        {
+            set_scan_level((ScanLevel)level);
+            double rps = run(req, seconds);
+            if(level == SCAN_SCALAR)
+                scalar = rps;
+            printf("%-8d %-8s %12.0f %10.1f %8.2f\n", (int)req.size(), scan_level_name((ScanLevel)level),
+                    rps, rps * req.size() / 1e6, rps / scalar);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * 比较MyReactor中原来的std::list<int> + mutex + cond分发队列
+ * 与无锁RingQueue<int>在1~64个线程下的吞吐
+ * 用法：./bench_queue [每轮元素个数]
+ */
+#include <iostream>
+#include <list>
+#include <vector>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "../reactor/RingQueue.h"
+
+/* 原来的分发队列 */
+class ListQueue
+{
+    public:
+        void push(int fd)
+        {
+            pthread_mutex_lock(&m_mutex);
+            m_list.push_back(fd);
+            pthread_mutex_unlock(&m_mutex);
+            pthread_cond_signal(&m_cond);
+        }
+
+        bool pop(int& fd)
+        {
+            pthread_mutex_lock(&m_mutex);
+            while(m_list.empty() && !m_closed)
+                pthread_cond_wait(&m_cond, &m_mutex);
+            if(m_list.empty())
+            {
+                pthread_mutex_unlock(&m_mutex);
+                return false;
+            }
+            fd = m_list.front();
+            m_list.pop_front();
+            pthread_mutex_unlock(&m_mutex);
+            return true;
+        }
+
+        void close()
+        {
+            pthread_mutex_lock(&m_mutex);
+            m_closed = true;
+            pthread_mutex_unlock(&m_mutex);
+            pthread_cond_broadcast(&m_cond);
+        }
+
+    private:
+        std::list<int> m_list;
+        bool m_closed = false;
+        pthread_mutex_t m_mutex = PTHREAD_MUTEX_INITIALIZER;
+        pthread_cond_t m_cond = PTHREAD_COND_INITIALIZER;
+};
+
+template<typename Q>
+struct BenchArg
+{
+    Q* queue;
+    long count;
+    long sum;
+};
+
+template<typename Q>
+void* producer_proc(void* args)
+{
+    BenchArg<Q>* arg = static_cast<BenchArg<Q>*>(args);
+    for(long i = 0; i < arg->count; i++)
+        arg->queue->push((int)(i & 0xffff));
+    return NULL;
+}
+
+template<typename Q>
+void* consumer_proc(void* args)
+{
+    BenchArg<Q>* arg = static_cast<BenchArg<Q>*>(args);
+    int fd;
+    while(arg->queue->pop(fd))
+        arg->sum += fd;
+    return NULL;
+}
+
+static double now_sec()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* nthreads个线程，一半生产者一半消费者，返回每秒传递的元素个数 */
+template<typename Q>
+double run(int nthreads, long total)
+{
+    Q queue;
+    int nproducer = nthreads / 2 > 0 ? nthreads / 2 : 1;
+    int nconsumer = nthreads - nproducer > 0 ? nthreads - nproducer : 1;
+
+    std::vector<pthread_t> producers(nproducer), consumers(nconsumer);
+    std::vector<BenchArg<Q> > pargs(nproducer), cargs(nconsumer);
+
+    double start = now_sec();
+    for(int i = 0; i < nconsumer; i++)
+    {
+        cargs[i].queue = &queue;
+        cargs[i].sum = 0;
+        pthread_create(&consumers[i], NULL, consumer_proc<Q>, &cargs[i]);
+    }
+    for(int i = 0; i < nproducer; i++)
+    {
+        pargs[i].queue = &queue;
+        pargs[i].count = total / nproducer;
+        pthread_create(&producers[i], NULL, producer_proc<Q>, &pargs[i]);
+    }
+
+    for(int i = 0; i < nproducer; i++)
+        pthread_join(producers[i], NULL);
+    queue.close();
+    for(int i = 0; i < nconsumer; i++)
+        pthread_join(consumers[i], NULL);
+
+    return (total / nproducer) * nproducer / (now_sec() - start);
+}
+
+int main(int argc, char* argv[])
+{
+    long total = argc > 1 ? atol(argv[1]) : 2000000;
+
+    printf("%8s %16s %16s\n", "threads", "list+mutex/s", "RingQueue/s");
+    for(int n = 1; n <= 64; n *= 2)
+    {
+        double list_rate = run<ListQueue>(n, total);
+        double ring_rate = run<RingQueue<int> >(n, total);
+        printf("%8d %16.0f %16.0f\n", n, list_rate, ring_rate);
+    }
+
+    return 0;
+}
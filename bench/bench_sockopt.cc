@@ -0,0 +1,289 @@
+/*
+ * 比较socket选项组对HTTP小文件延迟的影响：启动HTTP服务器，-p端口用default组，
+ * 另外用-L在后面两个端口上分别监听latency组和bulk组（见MyReactorHTTP/conf/socket.conf），
+ * 每个客户端线程反复请求/hello.txt，分两种方式统计吞吐和p50/p99/p999延迟：
+ *   keepalive  一个连接上一问一答
+ *   connect    每个请求新建一个连接，延迟包括握手
+ * 用法：./bench_sockopt [-p port] [-c 连接数] [-s 每项的秒数] [-M 服务器模式参数，如-s]
+ */
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+static const char* g_profiles[] = {"default", "latency", "bulk"};
+#define NPROFILES (int)(sizeof(g_profiles) / sizeof(g_profiles[0]))
+
+static volatile bool g_stop = false;
+static struct sockaddr_in g_addr;
+/* 每个请求是否新建连接 */
+static bool g_connect_each = false;
+
+static double now_sec()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int connect_server()
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(fd == -1)
+        return -1;
+    if(connect(fd, (const struct sockaddr*)&g_addr, sizeof(g_addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return fd;
+}
+
+/*
+ * 读完一个HTTP回复：响应头加上Content-length字节的正文，多读到的留给下一次
+ * 服务器回复了Connection: close时closed为true，调用者要重新连接
+ */
+static bool read_http_response(int fd, std::string* pending, bool* closed)
+{
+    while(true)
+    {
+        size_t end = pending->find("\r\n\r\n");
+        if(end != std::string::npos)
+        {
+            size_t body = 0;
+            size_t pos = pending->find("Content-length: ");
+            if(pos != std::string::npos && pos < end)
+                body = atol(pending->c_str() + pos + 16);
+            if(pending->size() >= end + 4 + body)
+            {
+                pos = pending->find("Connection: close");
+                *closed = pos != std::string::npos && pos < end;
+                pending->erase(0, end + 4 + body);
+                return true;
+            }
+        }
+
+        char buf[16384];
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if(n <= 0)
+            return false;
+        pending->append(buf, n);
+    }
+}
+
+struct ClientResult
+{
+    long requests;
+    bool failed;
+    /* 每个请求的往返时间，微秒 */
+    std::vector<double> latency_us;
+};
+
+void* client_proc(void* args)
+{
+    ClientResult* result = static_cast<ClientResult*>(args);
+    result->requests = 0;
+    result->failed = false;
+
+    const std::string msg = "GET /hello.txt HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    std::string pending;
+    int fd = -1;
+    while(!g_stop)
+    {
+        double start = now_sec();
+        if(fd == -1 && (fd = connect_server()) == -1)
+        {
+            result->failed = true;
+            break;
+        }
+        bool closed = false;
+        if(send(fd, msg.data(), msg.size(), 0) != (ssize_t)msg.size() || !read_http_response(fd, &pending, &closed))
+        {
+            result->failed = true;
+            break;
+        }
+        /* 连接上的请求数到了服务器的上限时也要重新连接 */
+        if(g_connect_each || closed)
+        {
+            close(fd);
+            fd = -1;
+            pending.clear();
+        }
+
+        result->latency_us.push_back((now_sec() - start) * 1e6);
+        result->requests++;
+    }
+
+    if(fd != -1)
+        close(fd);
+    return NULL;
+}
+
+static bool wait_server_ready(int port, double timeout_sec)
+{
+    g_addr.sin_port = htons(port);
+    double deadline = now_sec() + timeout_sec;
+    while(now_sec() < deadline)
+    {
+        int fd = connect_server();
+        if(fd != -1)
+        {
+            close(fd);
+            return true;
+        }
+        usleep(50 * 1000);
+    }
+    return false;
+}
+
+/* 在服务器目录下启动./main，它从./conf读取socket选项组；mode为空时不传 */
+static pid_t start_server(const char* dir, int port, const char* mode)
+{
+    pid_t pid = fork();
+    if(pid != 0)
+        return pid;
+
+    if(chdir(dir) != 0)
+        _exit(1);
+    /* 服务器的日志不参与比较 */
+    int null = open("/dev/null", O_RDWR);
+    if(null != -1)
+    {
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+    }
+    char portstr[16];
+    snprintf(portstr, sizeof(portstr), "%d", port);
+    std::vector<std::string> listen;
+    for(int i = 1; i < NPROFILES; i++)
+        listen.push_back("127.0.0.1:" + std::to_string(port + i) + "," + g_profiles[i]);
+
+    std::vector<const char*> argv;
+    argv.push_back("./main");
+    argv.push_back("-p");
+    argv.push_back(portstr);
+    for(size_t i = 0; i < listen.size(); i++)
+    {
+        argv.push_back("-L");
+        argv.push_back(listen[i].c_str());
+    }
+    if(mode != NULL)
+        argv.push_back(mode);
+    argv.push_back(NULL);
+    execv("./main", (char* const*)&argv[0]);
+    _exit(1);
+}
+
+static void run_profile(const char* workload, int profile, int port, int nconn, int seconds)
+{
+    g_addr.sin_port = htons(port + profile);
+    g_stop = false;
+    std::vector<ClientResult> results(nconn);
+    std::vector<pthread_t> threads(nconn);
+    double start = now_sec();
+    for(int i = 0; i < nconn; i++)
+        pthread_create(&threads[i], NULL, client_proc, &results[i]);
+
+    sleep(seconds);
+    g_stop = true;
+    for(int i = 0; i < nconn; i++)
+        pthread_join(threads[i], NULL);
+    double elapsed = now_sec() - start;
+
+    long requests = 0;
+    int failed = 0;
+    std::vector<double> latency;
+    for(int i = 0; i < nconn; i++)
+    {
+        requests += results[i].requests;
+        failed += results[i].failed ? 1 : 0;
+        latency.insert(latency.end(), results[i].latency_us.begin(), results[i].latency_us.end());
+    }
+    if(requests == 0)
+    {
+        printf("%-10s %-8s no request completed\n", workload, g_profiles[profile]);
+        return;
+    }
+
+    std::sort(latency.begin(), latency.end());
+    double p50 = latency[latency.size() / 2];
+    double p99 = latency[std::min(latency.size() - 1, latency.size() * 99 / 100)];
+    double p999 = latency[std::min(latency.size() - 1, latency.size() * 999 / 1000)];
+    printf("%-10s %-8s %12.0f %10.1f %10.1f %10.1f %8d\n",
+            workload, g_profiles[profile], requests / elapsed, p50, p99, p999, failed);
+}
+
+int main(int argc, char* argv[])
+{
+    int port = 12360;
+    int nconn = 8;
+    int seconds = 3;
+    const char* mode = NULL;
+
+    int ch;
+    while((ch = getopt(argc, argv, "p:c:s:M:")) != -1)
+    {
+        switch(ch)
+        {
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 'c':
+                nconn = atoi(optarg);
+                break;
+            case 's':
+                seconds = atoi(optarg);
+                break;
+            case 'M':
+                mode = optarg;
+                break;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+    memset(&g_addr, 0, sizeof(g_addr));
+    g_addr.sin_family = AF_INET;
+    g_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    pid_t pid = start_server("../MyReactorHTTP", port, mode);
+    bool ready = pid > 0;
+    for(int i = 0; ready && i < NPROFILES; i++)
+        ready = wait_server_ready(port + i, 3);
+    if(!ready)
+    {
+        printf("server did not start\n");
+        if(pid > 0)
+        {
+            kill(pid, SIGKILL);
+            waitpid(pid, NULL, 0);
+        }
+        return 1;
+    }
+
+    printf("connections=%d seconds=%d mode=%s\n", nconn, seconds, mode != NULL ? mode : "default");
+    printf("%-10s %-8s %12s %10s %10s %10s %8s\n",
+            "workload", "profile", "req/s", "p50 us", "p99 us", "p999 us", "failed");
+    for(int each = 0; each < 2; each++)
+    {
+        g_connect_each = each != 0;
+        for(int i = 0; i < NPROFILES; i++)
+            run_profile(g_connect_each ? "connect" : "keepalive", i, port, nconn, seconds);
+    }
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    return 0;
+}
@@ -0,0 +1,185 @@
+/*
+ * 比较原来的共享队列工作线程池（所有任务进同一个RingQueue）
+ * 与工作窃取的TaskScheduler在均匀和不均匀任务下的表现
+ *   uniform  主线程提交大小相同的任务
+ *   skewed   主线程提交的任务里每64个有一个大64倍
+ *   fanout   主线程只提交少量根任务，每个根任务在工作线程里再提交一批大小不一的子任务
+ * 输出耗时、每秒任务数、窃取率和各工作线程忙碌时间占比的最小/平均/最大值
+ * 用法：./bench_steal [工作线程数] [每轮任务数] [任务的基本计算量]
+ */
+#include <iostream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "../reactor/RingQueue.h"
+#include "../reactor/TaskScheduler.h"
+#include "../reactor/ReactorStats.h"
+
+/* 原来的工作线程池：一个共享的MPMC队列 */
+class FifoPool
+{
+    public:
+        void init(int workers) { (void)workers; }
+
+        void run()
+        {
+            Task* task;
+            while(m_queue.pop(task))
+            {
+                int64_t start = ReactorStats::now_ns();
+                (*task)();
+                delete task;
+                ReactorStats::add(&ThreadStats::tasks, 1);
+                ReactorStats::add(&ThreadStats::busy_ns, ReactorStats::now_ns() - start);
+            }
+        }
+
+        void submit(const Task& task) { m_queue.push(new Task(task)); }
+        void close() { m_queue.close(); }
+
+    private:
+        /* 工作线程自己也往里提交，队列满了会互相等死，这里开得足够大 */
+        RingQueue<Task*> m_queue{1 << 20};
+};
+
+static volatile uint64_t g_sink;
+
+/* 大约iterations次乘加的纯计算 */
+static void burn(long iterations)
+{
+    uint64_t x = 88172645463325252ULL;
+    for(long i = 0; i < iterations; i++)
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    g_sink = x;
+}
+
+template<typename Pool>
+struct Run
+{
+    Pool pool;
+    ReactorStats stats;
+    std::atomic<long> remaining{0};
+};
+
+template<typename Pool>
+void* worker_proc(void* args)
+{
+    Run<Pool>* run = static_cast<Run<Pool>*>(args);
+    run->stats.attach("worker");
+    run->pool.run();
+    return NULL;
+}
+
+template<typename Pool>
+static void leaf(Run<Pool>* run, long iterations)
+{
+    burn(iterations);
+    run->remaining.fetch_sub(1);
+}
+
+/* 从JSON里取一个数字字段，找不到时返回0 */
+static double json_number(const std::string& json, const char* key, size_t from = 0)
+{
+    std::string pattern = std::string("\"") + key + "\":";
+    size_t pos = json.find(pattern, from);
+    return pos == std::string::npos ? 0 : atof(json.c_str() + pos + pattern.size());
+}
+
+static double now_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+template<typename Pool>
+void bench(const char* workload, const char* name, int nthreads, long ntasks, long work)
+{
+    Run<Pool>* run = new Run<Pool>();
+    Run<Pool>* r = run;
+    run->pool.init(nthreads);
+    run->remaining.store(ntasks);
+
+    std::vector<pthread_t> threads(nthreads);
+    for(int i = 0; i < nthreads; i++)
+        pthread_create(&threads[i], NULL, worker_proc<Pool>, run);
+
+    double start = now_sec();
+    if(strcmp(workload, "fanout") == 0)
+    {
+        /* 每个根任务自己也算一个，子任务的大小在1到16倍之间循环 */
+        const long fanout = 64;
+        long roots = ntasks / (fanout + 1);
+        run->remaining.store(roots * (fanout + 1));
+        for(long i = 0; i < roots; i++)
+        {
+            run->pool.submit([r, work, fanout]() {
+                for(long k = 0; k < fanout; k++)
+                {
+                    long iterations = work * (1 + k % 16);
+                    r->pool.submit([r, iterations]() { leaf(r, iterations); });
+                }
+                r->remaining.fetch_sub(1);
+            });
+        }
+    }
+    else
+    {
+        bool skewed = strcmp(workload, "skewed") == 0;
+        for(long i = 0; i < ntasks; i++)
+        {
+            long iterations = skewed && i % 64 == 0 ? work * 64 : work;
+            run->pool.submit([r, iterations]() { leaf(r, iterations); });
+        }
+    }
+
+    while(run->remaining.load() > 0)
+        sched_yield();
+    double elapsed = now_sec() - start;
+
+    run->pool.close();
+    for(int i = 0; i < nthreads; i++)
+        pthread_join(threads[i], NULL);
+
+    /* 忙碌占比按本轮耗时算，线程启动的时间忽略不计 */
+    std::string total = run->stats.to_json(0, 0, false);
+    std::vector<std::string> per_thread = run->stats.thread_json();
+    double umin = 1e9, umax = 0, usum = 0;
+    for(size_t i = 0; i < per_thread.size(); i++)
+    {
+        double u = json_number(per_thread[i], "busy_ns") / 1e9 / elapsed;
+        umin = u < umin ? u : umin;
+        umax = u > umax ? u : umax;
+        usum += u;
+    }
+    double tasks = json_number(total, "tasks");
+
+    printf("%-8s %-10s %9.3f %12.0f %10.4f %6.2f %6.2f %6.2f\n", workload, name, elapsed, tasks / elapsed,
+            tasks > 0 ? json_number(total, "steals") / tasks : 0.0,
+            umin, per_thread.empty() ? 0.0 : usum / per_thread.size(), umax);
+    delete run;
+}
+
+int main(int argc, char* argv[])
+{
+    int nthreads = argc > 1 ? atoi(argv[1]) : 4;
+    long ntasks = argc > 2 ? atol(argv[2]) : 200000;
+    long work = argc > 3 ? atol(argv[3]) : 2000;
+
+    printf("%d workers, %ld tasks, work = %ld\n", nthreads, ntasks, work);
+    printf("%-8s %-10s %9s %12s %10s %6s %6s %6s\n", "workload", "pool", "seconds", "tasks/s", "steal_rate", "umin", "uavg", "umax");
+    const char* workloads[] = {"uniform", "skewed", "fanout"};
+    for(size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++)
+    {
+        bench<FifoPool>(workloads[i], "fifo", nthreads, ntasks, work);
+        bench<TaskScheduler>(workloads[i], "stealing", nthreads, ntasks, work);
+    }
+
+    return 0;
+}
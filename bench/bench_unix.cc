@@ -0,0 +1,351 @@
+/*
+ * 比较同机客户走TCP回环和走unix socket的延迟：依次启动echo和HTTP服务器，
+ * 除了TCP端口再用-L监听一个路径形式和一个抽象命名空间的unix socket，
+ * 每个客户端线程一个连接，一问一答，分别统计三种连接方式的吞吐和p50/p99/p999延迟
+ * 用法：./bench_unix [-p port] [-c 连接数] [-s 每种方式的秒数] [-M 服务器模式参数，如-s]
+ */
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define UNIX_PATH "/tmp/bench_unix.sock"
+#define ABSTRACT_NAME "@bench_unix"
+
+/* 一种连接方式：地址和长度 */
+struct Target
+{
+    const char* name;
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+};
+
+static volatile bool g_stop = false;
+static const Target* g_target = NULL;
+/* 0是echo，1是HTTP */
+static int g_http = 0;
+
+static double now_sec()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void make_tcp(Target* t, int port)
+{
+    memset(t, 0, sizeof(*t));
+    t->name = "tcp";
+    struct sockaddr_in* in = (struct sockaddr_in*)&t->addr;
+    in->sin_family = AF_INET;
+    in->sin_addr.s_addr = inet_addr("127.0.0.1");
+    in->sin_port = htons(port);
+    t->addrlen = sizeof(struct sockaddr_in);
+}
+
+/* name以'@'开头时是抽象命名空间，地址长度不包括结尾的'\0' */
+static void make_unix(Target* t, const char* label, const char* name)
+{
+    memset(t, 0, sizeof(*t));
+    t->name = label;
+    struct sockaddr_un* un = (struct sockaddr_un*)&t->addr;
+    un->sun_family = AF_UNIX;
+    strncpy(un->sun_path, name, sizeof(un->sun_path) - 1);
+    if(name[0] == '@')
+    {
+        un->sun_path[0] = '\0';
+        t->addrlen = offsetof(struct sockaddr_un, sun_path) + strlen(name);
+    }
+    else
+        t->addrlen = sizeof(struct sockaddr_un);
+}
+
+static int connect_target(const Target* t)
+{
+    int fd = socket(t->addr.ss_family, SOCK_STREAM, 0);
+    if(fd == -1)
+        return -1;
+    if(connect(fd, (const struct sockaddr*)&t->addr, t->addrlen) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    if(t->addr.ss_family == AF_INET)
+    {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    return fd;
+}
+
+/*
+ * 读完一个HTTP回复：响应头加上Content-length字节的正文，多读到的留给下一次
+ * 服务器回复了Connection: close时closed为true，调用者要重新连接
+ */
+static bool read_http_response(int fd, std::string* pending, bool* closed)
+{
+    while(true)
+    {
+        size_t end = pending->find("\r\n\r\n");
+        if(end != std::string::npos)
+        {
+            size_t body = 0;
+            size_t pos = pending->find("Content-length: ");
+            if(pos != std::string::npos && pos < end)
+                body = atol(pending->c_str() + pos + 16);
+            if(pending->size() >= end + 4 + body)
+            {
+                pos = pending->find("Connection: close");
+                *closed = pos != std::string::npos && pos < end;
+                pending->erase(0, end + 4 + body);
+                return true;
+            }
+        }
+
+        char buf[16384];
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if(n <= 0)
+            return false;
+        pending->append(buf, n);
+    }
+}
+
+struct ClientResult
+{
+    long requests;
+    bool failed;
+    /* 每个请求的往返时间，微秒 */
+    std::vector<double> latency_us;
+};
+
+void* client_proc(void* args)
+{
+    ClientResult* result = static_cast<ClientResult*>(args);
+    result->requests = 0;
+    result->failed = true;
+
+    int fd = connect_target(g_target);
+    if(fd == -1)
+        return NULL;
+
+    std::string msg = g_http ? "GET /hello.txt HTTP/1.1\r\nHost: localhost\r\n\r\n" : std::string(63, 'x') + "\n";
+    std::string pending;
+    result->failed = false;
+
+    while(!g_stop)
+    {
+        double start = now_sec();
+        if(send(fd, msg.data(), msg.size(), 0) != (ssize_t)msg.size())
+        {
+            result->failed = true;
+            break;
+        }
+
+        /* echo的回复是时间戳加上原消息，收到换行才算一次请求完成 */
+        bool done = false;
+        bool closed = false;
+        if(g_http)
+            done = read_http_response(fd, &pending, &closed);
+        else
+        {
+            char buf[1024];
+            while(!done)
+            {
+                ssize_t n = recv(fd, buf, sizeof(buf), 0);
+                if(n <= 0)
+                    break;
+                done = buf[n - 1] == '\n';
+            }
+        }
+        if(!done)
+        {
+            result->failed = true;
+            break;
+        }
+
+        result->latency_us.push_back((now_sec() - start) * 1e6);
+        result->requests++;
+
+        /* 连接上的请求数到了服务器的上限 */
+        if(closed)
+        {
+            close(fd);
+            pending.clear();
+            if((fd = connect_target(g_target)) == -1)
+            {
+                result->failed = true;
+                return NULL;
+            }
+        }
+    }
+
+    close(fd);
+    return NULL;
+}
+
+static bool wait_server_ready(const Target* t, double timeout_sec)
+{
+    double deadline = now_sec() + timeout_sec;
+    while(now_sec() < deadline)
+    {
+        int fd = connect_target(t);
+        if(fd != -1)
+        {
+            close(fd);
+            return true;
+        }
+        usleep(50 * 1000);
+    }
+    return false;
+}
+
+/* 在服务器目录下启动./main，它从./conf读取日志和线程配置；mode为空时不传 */
+static pid_t start_server(const char* dir, int port, const char* mode)
+{
+    pid_t pid = fork();
+    if(pid != 0)
+        return pid;
+
+    if(chdir(dir) != 0)
+        _exit(1);
+    /* 服务器的日志不参与比较 */
+    int null = open("/dev/null", O_RDWR);
+    if(null != -1)
+    {
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+    }
+    char portstr[16];
+    snprintf(portstr, sizeof(portstr), "%d", port);
+    const char* argv[12];
+    int argc = 0;
+    argv[argc++] = "./main";
+    argv[argc++] = "-p";
+    argv[argc++] = portstr;
+    argv[argc++] = "-L";
+    argv[argc++] = "unix:" UNIX_PATH;
+    argv[argc++] = "-L";
+    argv[argc++] = "unix:" ABSTRACT_NAME;
+    if(mode != NULL)
+        argv[argc++] = mode;
+    argv[argc] = NULL;
+    execv("./main", (char* const*)argv);
+    _exit(1);
+}
+
+static void run_target(const char* server, const Target* t, int nconn, int seconds)
+{
+    g_target = t;
+    g_stop = false;
+    std::vector<ClientResult> results(nconn);
+    std::vector<pthread_t> threads(nconn);
+    double start = now_sec();
+    for(int i = 0; i < nconn; i++)
+        pthread_create(&threads[i], NULL, client_proc, &results[i]);
+
+    sleep(seconds);
+    g_stop = true;
+    for(int i = 0; i < nconn; i++)
+        pthread_join(threads[i], NULL);
+    double elapsed = now_sec() - start;
+
+    long requests = 0;
+    int failed = 0;
+    std::vector<double> latency;
+    for(int i = 0; i < nconn; i++)
+    {
+        requests += results[i].requests;
+        failed += results[i].failed ? 1 : 0;
+        latency.insert(latency.end(), results[i].latency_us.begin(), results[i].latency_us.end());
+    }
+    if(requests == 0)
+    {
+        printf("%-6s %-10s no request completed\n", server, t->name);
+        return;
+    }
+
+    std::sort(latency.begin(), latency.end());
+    double p50 = latency[latency.size() / 2];
+    double p99 = latency[std::min(latency.size() - 1, latency.size() * 99 / 100)];
+    double p999 = latency[std::min(latency.size() - 1, latency.size() * 999 / 1000)];
+    printf("%-6s %-10s %12.0f %10.1f %10.1f %10.1f %8d\n",
+            server, t->name, requests / elapsed, p50, p99, p999, failed);
+}
+
+static void run(const char* server, const char* dir, int http, int port, const char* mode,
+        int nconn, int seconds)
+{
+    Target targets[3];
+    make_tcp(&targets[0], port);
+    make_unix(&targets[1], "unix", UNIX_PATH);
+    make_unix(&targets[2], "abstract", ABSTRACT_NAME);
+
+    pid_t pid = start_server(dir, port, mode);
+    if(pid < 0 || !wait_server_ready(&targets[0], 3) || !wait_server_ready(&targets[1], 1))
+    {
+        printf("%-6s server did not start\n", server);
+        if(pid > 0)
+        {
+            kill(pid, SIGKILL);
+            waitpid(pid, NULL, 0);
+        }
+        return;
+    }
+
+    g_http = http;
+    for(int i = 0; i < 3; i++)
+        run_target(server, &targets[i], nconn, seconds);
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+int main(int argc, char* argv[])
+{
+    int port = 12347;
+    int nconn = 8;
+    int seconds = 3;
+    const char* mode = NULL;
+
+    int ch;
+    while((ch = getopt(argc, argv, "p:c:s:M:")) != -1)
+    {
+        switch(ch)
+        {
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 'c':
+                nconn = atoi(optarg);
+                break;
+            case 's':
+                seconds = atoi(optarg);
+                break;
+            case 'M':
+                mode = optarg;
+                break;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("connections=%d seconds=%d mode=%s\n", nconn, seconds, mode != NULL ? mode : "default");
+    printf("%-6s %-10s %12s %10s %10s %10s %8s\n",
+            "server", "transport", "req/s", "p50 us", "p99 us", "p999 us", "failed");
+    run("echo", "../myreactor/v5.0", 0, port, mode, nconn, seconds);
+    run("http", "../MyReactorHTTP", 1, port, mode, nconn, seconds);
+    return 0;
+}
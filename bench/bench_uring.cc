@@ -0,0 +1,254 @@
+/*
+ * 比较epoll和io_uring两种后端：在同一个echo负载下依次启动myreactor/v5.0的服务器
+ * （-r为epoll + SO_REUSEPORT，-u为io_uring），每个客户端线程一个连接，
+ * 发一条定长消息、等带时间戳的回复收齐后再发下一条，统计吞吐、延迟分位数，
+ * 以及从/proc/<pid>/stat读出的服务器每个请求消耗的CPU时间
+ * 用法：./bench_uring [-e 服务器目录] [-p port] [-c 连接数] [-m 消息字节数] [-s 秒数]
+ */
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+static struct sockaddr_in g_servaddr;
+static volatile bool g_stop = false;
+static size_t g_msg_size = 64;
+
+static double now_sec()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+struct ClientResult
+{
+    long requests;
+    bool failed;
+    /* 每个请求的往返时间，微秒 */
+    std::vector<double> latency_us;
+};
+
+void* client_proc(void* args)
+{
+    ClientResult* result = static_cast<ClientResult*>(args);
+    result->requests = 0;
+    result->failed = true;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(fd == -1)
+        return NULL;
+    if(connect(fd, (struct sockaddr*)&g_servaddr, sizeof(g_servaddr)) != 0)
+    {
+        close(fd);
+        return NULL;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    std::string msg(g_msg_size - 1, 'x');
+    msg += '\n';
+    std::vector<char> buf(g_msg_size + 256);
+    result->failed = false;
+
+    while(!g_stop)
+    {
+        double start = now_sec();
+        if(send(fd, msg.data(), msg.size(), 0) != (ssize_t)msg.size())
+        {
+            result->failed = true;
+            break;
+        }
+
+        /* 回复是时间戳加上原消息，收到换行才算一次请求完成 */
+        bool done = false;
+        while(!done)
+        {
+            ssize_t n = recv(fd, &buf[0], buf.size(), 0);
+            if(n <= 0)
+                break;
+            done = buf[n - 1] == '\n';
+        }
+        if(!done)
+        {
+            result->failed = true;
+            break;
+        }
+
+        result->latency_us.push_back((now_sec() - start) * 1e6);
+        result->requests++;
+    }
+
+    close(fd);
+    return NULL;
+}
+
+/* 进程累计的用户态和内核态CPU时间，秒 */
+static double process_cpu_sec(pid_t pid)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    FILE* fp = fopen(path, "r");
+    if(fp == NULL)
+        return 0;
+
+    char line[1024];
+    size_t len = fread(line, 1, sizeof(line) - 1, fp);
+    fclose(fp);
+    line[len] = '\0';
+
+    /* 进程名可能带空格，从最后一个')'之后开始数，utime和stime是第14、15个字段 */
+    char* p = strrchr(line, ')');
+    if(p == NULL)
+        return 0;
+    unsigned long utime = 0, stime = 0;
+    if(sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2)
+        return 0;
+    return (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+static bool wait_server_ready(double timeout_sec)
+{
+    double deadline = now_sec() + timeout_sec;
+    while(now_sec() < deadline)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        bool ok = connect(fd, (struct sockaddr*)&g_servaddr, sizeof(g_servaddr)) == 0;
+        close(fd);
+        if(ok)
+            return true;
+        usleep(50 * 1000);
+    }
+    return false;
+}
+
+/* 在服务器目录下启动./main，它从./conf读取日志和线程配置 */
+static pid_t start_server(const char* dir, int port, const char* mode)
+{
+    pid_t pid = fork();
+    if(pid != 0)
+        return pid;
+
+    if(chdir(dir) != 0)
+        _exit(1);
+    /* 服务器的日志不参与比较 */
+    int null = open("/dev/null", O_RDWR);
+    if(null != -1)
+    {
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+    }
+    char portstr[16];
+    snprintf(portstr, sizeof(portstr), "%d", port);
+    execl("./main", "./main", "-p", portstr, mode, (char*)NULL);
+    _exit(1);
+}
+
+static void run(const char* dir, int port, const char* mode, const char* name, int nconn, int seconds)
+{
+    pid_t pid = start_server(dir, port, mode);
+    if(pid < 0 || !wait_server_ready(3))
+    {
+        printf("%-8s server did not start\n", name);
+        if(pid > 0)
+        {
+            kill(pid, SIGKILL);
+            waitpid(pid, NULL, 0);
+        }
+        return;
+    }
+
+    g_stop = false;
+    std::vector<ClientResult> results(nconn);
+    std::vector<pthread_t> threads(nconn);
+    double cpu_start = process_cpu_sec(pid);
+    double start = now_sec();
+    for(int i = 0; i < nconn; i++)
+        pthread_create(&threads[i], NULL, client_proc, &results[i]);
+
+    sleep(seconds);
+    g_stop = true;
+    for(int i = 0; i < nconn; i++)
+        pthread_join(threads[i], NULL);
+    double elapsed = now_sec() - start;
+    double cpu = process_cpu_sec(pid) - cpu_start;
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+
+    long requests = 0;
+    int failed = 0;
+    std::vector<double> latency;
+    for(int i = 0; i < nconn; i++)
+    {
+        requests += results[i].requests;
+        failed += results[i].failed ? 1 : 0;
+        latency.insert(latency.end(), results[i].latency_us.begin(), results[i].latency_us.end());
+    }
+    if(requests == 0)
+    {
+        printf("%-8s no request completed\n", name);
+        return;
+    }
+
+    std::sort(latency.begin(), latency.end());
+    double p50 = latency[latency.size() / 2];
+    double p99 = latency[std::min(latency.size() - 1, latency.size() * 99 / 100)];
+    printf("%-8s %12.0f %10.1f %10.1f %14.2f %8d\n",
+            name, requests / elapsed, p50, p99, cpu * 1e6 / requests, failed);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* dir = "../myreactor/v5.0";
+    int port = 12346;
+    int nconn = 64;
+    int seconds = 5;
+
+    int ch;
+    while((ch = getopt(argc, argv, "e:p:c:m:s:")) != -1)
+    {
+        switch(ch)
+        {
+            case 'e':
+                dir = optarg;
+                break;
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 'c':
+                nconn = atoi(optarg);
+                break;
+            case 'm':
+                g_msg_size = atoi(optarg) > 1 ? atoi(optarg) : 2;
+                break;
+            case 's':
+                seconds = atoi(optarg);
+                break;
+        }
+    }
+
+    memset(&g_servaddr, 0, sizeof(g_servaddr));
+    g_servaddr.sin_family = AF_INET;
+    g_servaddr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    g_servaddr.sin_port = htons(port);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("connections=%d msg bytes=%d seconds=%d\n", nconn, (int)g_msg_size, seconds);
+    printf("%-8s %12s %10s %10s %14s %8s\n", "backend", "req/s", "p50 us", "p99 us", "server cpu us", "failed");
+    run(dir, port, "-r", "epoll", nconn, seconds);
+    run(dir, port, "-u", "io_uring", nconn, seconds);
+    return 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * 比较线程间通知的两种方式
+ * 1. 原来的mutex + pthread_cond_signal交接
+ * 2. eventfd注册在epoll中的TaskQueue（run in loop）
+ * 两个线程互相乒乓，得到一次交接的平均延迟；
+ * 另外比较循环线程的退出延迟：原来每10ms醒来检查标志 vs eventfd直接唤醒。
+ * 用法：./bench_wakeup [乒乓次数]
+ */
+#include <vector>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/epoll.h>
+
+#include "../reactor/Wakeup.h"
+
+static double now_sec()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+
+/* 原来的交接方式：每一方一个条件变量，turn表示轮到谁 */
+struct CondPingPong
+{
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t cond[2] = {PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER};
+    int turn = 0;
+    long rounds;
+};
+
+struct CondArg
+{
+    CondPingPong* pp;
+    int self;
+};
+
+void* cond_proc(void* args)
+{
+    CondArg* arg = static_cast<CondArg*>(args);
+    CondPingPong* pp = arg->pp;
+    int self = arg->self;
+
+    pthread_mutex_lock(&pp->mutex);
+    for(long i = 0; i < pp->rounds; i++)
+    {
+        while(pp->turn != self)
+            pthread_cond_wait(&pp->cond[self], &pp->mutex);
+        pp->turn = 1 - self;
+        pthread_cond_signal(&pp->cond[1 - self]);
+    }
+    pthread_mutex_unlock(&pp->mutex);
+    return NULL;
+}
+
+/* 返回一次交接的平均微秒数 */
+double run_cond(long rounds)
+{
+    CondPingPong pp;
+    pp.rounds = rounds;
+    CondArg args[2] = {{&pp, 0}, {&pp, 1}};
+    pthread_t tid[2];
+
+    double start = now_sec();
+    for(int i = 0; i < 2; i++)
+        pthread_create(&tid[i], NULL, cond_proc, &args[i]);
+    for(int i = 0; i < 2; i++)
+        pthread_join(tid[i], NULL);
+    return (now_sec() - start) * 1e6 / (rounds * 2);
+}
+
+
+/* 一个最小的事件循环：epoll里只注册了自己的TaskQueue */
+struct Loop
+{
+    int epollfd;
+    TaskQueue tasks;
+    bool stop = false;
+    /* 为true时按原来的方式每10ms醒来检查stop */
+    bool polling = false;
+    Loop* peer;
+    long remain;
+};
+
+void* loop_proc(void* args)
+{
+    Loop* loop = static_cast<Loop*>(args);
+    while(!loop->stop)
+    {
+        struct epoll_event ev[8];
+        int n = epoll_wait(loop->epollfd, ev, 8, loop->polling ? 10 : -1);
+        for(int i = 0; i < n; i++)
+        {
+            if(ev[i].data.fd == loop->tasks.fd())
+                loop->tasks.run_pending();
+        }
+    }
+    return NULL;
+}
+
+void init_loop(Loop* loop)
+{
+    loop->epollfd = epoll_create(1);
+    struct epoll_event e;
+    e.events = EPOLLIN;
+    e.data.fd = loop->tasks.fd();
+    epoll_ctl(loop->epollfd, EPOLL_CTL_ADD, loop->tasks.fd(), &e);
+}
+
+/* 在loop上执行一次后把球投递给对方 */
+void bounce(Loop* loop)
+{
+    if(--loop->remain < 0)
+    {
+        loop->stop = true;
+        loop->peer->stop = true;
+        loop->peer->tasks.notify();
+        return;
+    }
+    Loop* peer = loop->peer;
+    peer->tasks.post([peer]() { bounce(peer); });
+}
+
+double run_eventfd(long rounds)
+{
+    Loop loops[2];
+    for(int i = 0; i < 2; i++)
+    {
+        init_loop(&loops[i]);
+        loops[i].peer = &loops[1 - i];
+        loops[i].remain = rounds;
+    }
+
+    pthread_t tid[2];
+    double start = now_sec();
+    for(int i = 0; i < 2; i++)
+        pthread_create(&tid[i], NULL, loop_proc, &loops[i]);
+    Loop* first = &loops[0];
+    first->tasks.post([first]() { bounce(first); });
+    for(int i = 0; i < 2; i++)
+        pthread_join(tid[i], NULL);
+    double elapsed = now_sec() - start;
+
+    for(int i = 0; i < 2; i++)
+        close(loops[i].epollfd);
+    return elapsed * 1e6 / (rounds * 2);
+}
+
+
+/* 从要求退出到线程结束的平均微秒数 */
+double run_shutdown(bool polling, int times)
+{
+    double total = 0;
+    for(int i = 0; i < times; i++)
+    {
+        Loop loop;
+        init_loop(&loop);
+        loop.polling = polling;
+
+        pthread_t tid;
+        pthread_create(&tid, NULL, loop_proc, &loop);
+        /* 错开一点，让退出请求落在10ms周期中的不同位置 */
+        usleep(1000 + (i * 3717) % 10000);
+
+        double start = now_sec();
+        loop.stop = true;
+        if(!polling)
+            loop.tasks.notify();
+        pthread_join(tid, NULL);
+        total += now_sec() - start;
+        close(loop.epollfd);
+    }
+    return total * 1e6 / times;
+}
+
+int main(int argc, char* argv[])
+{
+    long rounds = argc > 1 ? atol(argv[1]) : 200000;
+
+    printf("%-28s %12s\n", "handoff", "us/handoff");
+    printf("%-28s %12.2f\n", "mutex+cond", run_cond(rounds));
+    printf("%-28s %12.2f\n", "eventfd TaskQueue in epoll", run_eventfd(rounds));
+
+    printf("\n%-28s %12s\n", "shutdown", "us");
+    printf("%-28s %12.0f\n", "epoll_wait 10ms polling", run_shutdown(true, 50));
+    printf("%-28s %12.0f\n", "eventfd notify", run_shutdown(false, 50));
+
+    return 0;
+}
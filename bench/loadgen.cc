@@ -0,0 +1,761 @@
+/*
+ * 多连接的压测客户端，可以压myreactor/v5.0的echo服务器、MyReactorChat和MyReactorHTTP
+ * 每个线程一个epoll，连接平均分给各线程，全部是非阻塞socket
+ * 闭环模式下每个连接始终保持depth个请求在途，收到一个回复就补发一个；
+ * 开环模式（-R）按固定速率发请求，延迟从计划发送的时刻算起，服务器变慢时排队的时间也算进去
+ * 结果是一行JSON，写到标准输出，出错信息写到标准错误
+ * 用法：./loadgen [-h host] [-p port] [-P echo|chat|http] [-c 连接数] [-t 线程数] [-d 每个连接的在途请求数]
+ *                [-m 消息字节数] [-R 每秒请求数，0为闭环] [-s 秒数] [-w 预热秒数] [-u http路径]
+ *                [-T 超时毫秒] [-e 服务器目录] [-M 服务器参数] [-n 结果的名字]
+ * 给出-e时先在该目录下启动./main，压完之后再结束它
+ */
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+enum Protocol
+{
+    /* 一行一个请求，回复也以换行结束 */
+    PROTO_ECHO,
+    /* 和echo一样按行，但每条消息会广播给所有连接，只有带着自己编号的那行才是自己的回复 */
+    PROTO_CHAT,
+    /* GET请求，按Content-length找到回复的结尾 */
+    PROTO_HTTP
+};
+
+struct Options
+{
+    std::string host = "127.0.0.1";
+    int port = 12345;
+    Protocol protocol = PROTO_ECHO;
+    int conns = 64;
+    int threads = 1;
+    int depth = 1;
+    int payload = 64;
+    /* 所有连接加起来每秒的请求数，0表示闭环 */
+    double rate = 0;
+    int seconds = 10;
+    int warmup = 1;
+    std::string path = "/hello.txt";
+    int timeout_ms = 5000;
+    std::string server_dir;
+    std::string server_args;
+    std::string name;
+};
+
+static Options g_opt;
+static struct sockaddr_in g_servaddr;
+static std::atomic<bool> g_stop(false);
+/* 只统计计划发送时间落在[g_measure_start, g_measure_end)之内的请求 */
+static std::atomic<int64_t> g_measure_start(0);
+static std::atomic<int64_t> g_measure_end(INT64_MAX);
+
+static int64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* chat模式下消息里的连接编号，固定宽度，方便在广播回来的行里找 */
+#define TAG_DIGITS 7
+
+struct Conn
+{
+    int fd = -1;
+    int id = 0;
+    bool connected = false;
+    /* 是否在等EPOLLOUT */
+    bool want_write = false;
+    /* 一个请求的完整内容，连接建立时生成 */
+    std::string request;
+    std::string out;
+    size_t out_off = 0;
+    std::string in;
+    /* 在途请求的发送时间，开环模式下是计划发送的时间 */
+    std::deque<int64_t> inflight;
+    /* http回复的解析状态：正在跳过的body还剩多少字节 */
+    bool in_body = false;
+    size_t body_left = 0;
+    /* 收到了Connection: close的回复，之后的请求服务器不会回答 */
+    bool server_close = false;
+};
+
+struct Worker
+{
+    pthread_t tid;
+    int epollfd = -1;
+    int timerfd = -1;
+    std::vector<Conn> conns;
+    /* 开环模式下本线程的速率、起始时间和已经排上的请求数 */
+    double rate = 0;
+    int64_t start_ns = 0;
+    int64_t planned = 0;
+    size_t next_conn = 0;
+    int64_t next_scan_ns = 0;
+
+    /* 结果 */
+    std::vector<float> latency_us;
+    long requests = 0;
+    long errors = 0;
+    long timeouts = 0;
+    long reconnects = 0;
+    long deliveries = 0;
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+};
+
+static void start_connect(Worker* w, Conn* c);
+
+static void update_events(Worker* w, Conn* c)
+{
+    struct epoll_event e;
+    memset(&e, 0, sizeof(e));
+    e.events = EPOLLIN | (c->want_write || !c->connected ? EPOLLOUT : 0);
+    e.data.u32 = c - &w->conns[0];
+    epoll_ctl(w->epollfd, EPOLL_CTL_MOD, c->fd, &e);
+}
+
+/* 连接出错或者被对端关闭，在途的请求算失败，稍后由定时扫描重连 */
+static void conn_failed(Worker* w, Conn* c)
+{
+    if(c->fd == -1)
+        return;
+    epoll_ctl(w->epollfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+    c->connected = false;
+    c->want_write = false;
+    w->errors += c->inflight.size();
+    c->inflight.clear();
+    c->out.clear();
+    c->out_off = 0;
+    c->in.clear();
+    c->in_body = false;
+    c->server_close = false;
+    w->reconnects++;
+}
+
+/* 服务器按约定关闭了连接（比如请求数到了上限），没有回答的请求不算失败，马上重连 */
+static void conn_reopen(Worker* w, Conn* c)
+{
+    c->inflight.clear();
+    conn_failed(w, c);
+    if(!g_stop.load(std::memory_order_relaxed))
+        start_connect(w, c);
+}
+
+static void flush(Worker* w, Conn* c)
+{
+    while(c->out_off < c->out.size())
+    {
+        ssize_t n = send(c->fd, c->out.data() + c->out_off, c->out.size() - c->out_off, MSG_NOSIGNAL);
+        if(n > 0)
+        {
+            c->out_off += n;
+            w->bytes_out += n;
+            continue;
+        }
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            if(!c->want_write)
+            {
+                c->want_write = true;
+                update_events(w, c);
+            }
+            return;
+        }
+        conn_failed(w, c);
+        return;
+    }
+
+    c->out.clear();
+    c->out_off = 0;
+    if(c->want_write)
+    {
+        c->want_write = false;
+        update_events(w, c);
+    }
+}
+
+/* 把一个请求追加到输出缓冲区，调用者负责flush */
+static void queue_request(Conn* c, int64_t send_ns)
+{
+    c->out += c->request;
+    c->inflight.push_back(send_ns);
+}
+
+static void complete(Worker* w, Conn* c, int64_t now)
+{
+    if(c->inflight.empty())
+        return;
+    int64_t sent = c->inflight.front();
+    c->inflight.pop_front();
+    if(sent >= g_measure_start.load(std::memory_order_relaxed) && now < g_measure_end.load(std::memory_order_relaxed))
+    {
+        w->latency_us.push_back((now - sent) / 1000.0f);
+        w->requests++;
+    }
+
+    /* 闭环：收到一个回复马上补一个 */
+    if(g_opt.rate == 0 && !g_stop.load(std::memory_order_relaxed))
+        queue_request(c, now);
+}
+
+/* 在一行里找"#编号#"，找不到返回-1 */
+static int parse_tag(const char* line, size_t len)
+{
+    for(size_t i = 0; i + TAG_DIGITS + 1 < len; i++)
+    {
+        if(line[i] != '#' || line[i + TAG_DIGITS + 1] != '#')
+            continue;
+        int id = 0;
+        size_t k = 1;
+        for(; k <= TAG_DIGITS && line[i + k] >= '0' && line[i + k] <= '9'; k++)
+            id = id * 10 + (line[i + k] - '0');
+        if(k == TAG_DIGITS + 1)
+            return id;
+    }
+    return -1;
+}
+
+/* 按行切分回复，echo服务器一次读到的几行只加一个时间戳，但换行的个数不变 */
+static void parse_lines(Worker* w, Conn* c, int64_t now)
+{
+    size_t pos = 0;
+    while(true)
+    {
+        const char* nl = static_cast<const char*>(memchr(c->in.data() + pos, '\n', c->in.size() - pos));
+        if(nl == NULL)
+            break;
+        size_t len = nl - (c->in.data() + pos);
+        w->deliveries++;
+        if(g_opt.protocol == PROTO_ECHO || parse_tag(c->in.data() + pos, len) == c->id)
+            complete(w, c, now);
+        pos += len + 1;
+    }
+    c->in.erase(0, pos);
+}
+
+static void parse_http(Worker* w, Conn* c, int64_t now)
+{
+    size_t pos = 0;
+    while(pos < c->in.size())
+    {
+        if(!c->in_body)
+        {
+            size_t end = c->in.find("\r\n\r\n", pos);
+            if(end == std::string::npos)
+                break;
+
+            /* 头部不区分大小写，Tiny回的是Content-length */
+            c->body_left = 0;
+            for(size_t line = pos; line < end; )
+            {
+                size_t eol = c->in.find("\r\n", line);
+                if(strncasecmp(c->in.data() + line, "Content-length:", 15) == 0)
+                    c->body_left = strtoul(c->in.data() + line + 15, NULL, 10);
+                else if(strncasecmp(c->in.data() + line, "Connection: close", 17) == 0)
+                    c->server_close = true;
+                line = eol + 2;
+            }
+            c->in_body = true;
+            pos = end + 4;
+        }
+
+        size_t n = std::min(c->body_left, c->in.size() - pos);
+        c->body_left -= n;
+        pos += n;
+        if(c->body_left > 0)
+            break;
+
+        c->in_body = false;
+        w->deliveries++;
+        complete(w, c, now);
+        if(c->server_close)
+            break;
+    }
+    c->in.erase(0, pos);
+}
+
+static void handle_read(Worker* w, Conn* c)
+{
+    char buf[65536];
+    while(true)
+    {
+        ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+        if(n > 0)
+        {
+            c->in.append(buf, n);
+            w->bytes_in += n;
+            if((size_t)n < sizeof(buf))
+                break;
+            continue;
+        }
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        /* 对端关闭或出错，先把已经收到的回复算完 */
+        int64_t now = now_ns();
+        if(g_opt.protocol == PROTO_HTTP)
+            parse_http(w, c, now);
+        else
+            parse_lines(w, c, now);
+        if(c->server_close)
+            conn_reopen(w, c);
+        else
+            conn_failed(w, c);
+        return;
+    }
+
+    int64_t now = now_ns();
+    if(g_opt.protocol == PROTO_HTTP)
+        parse_http(w, c, now);
+    else
+        parse_lines(w, c, now);
+    if(c->server_close)
+    {
+        conn_reopen(w, c);
+        return;
+    }
+    flush(w, c);
+}
+
+static void handle_connected(Worker* w, Conn* c)
+{
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if(getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0)
+    {
+        conn_failed(w, c);
+        return;
+    }
+    c->connected = true;
+    update_events(w, c);
+
+    /* 闭环一连上就把depth个请求一起发出去 */
+    if(g_opt.rate == 0)
+    {
+        int64_t now = now_ns();
+        for(int i = 0; i < g_opt.depth; i++)
+            queue_request(c, now);
+        flush(w, c);
+    }
+}
+
+static void start_connect(Worker* w, Conn* c)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd == -1)
+        return;
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    if(connect(fd, (struct sockaddr*)&g_servaddr, sizeof(g_servaddr)) != 0 && errno != EINPROGRESS)
+    {
+        close(fd);
+        return;
+    }
+
+    c->fd = fd;
+    c->connected = false;
+    struct epoll_event e;
+    memset(&e, 0, sizeof(e));
+    e.events = EPOLLIN | EPOLLOUT;
+    e.data.u32 = c - &w->conns[0];
+    epoll_ctl(w->epollfd, EPOLL_CTL_ADD, fd, &e);
+}
+
+/* 开环：按本线程的速率算出到现在应该发出的请求数，轮流分给在途请求没满的连接 */
+static void send_due(Worker* w, int64_t now)
+{
+    int64_t target = (int64_t)((now - w->start_ns) / 1e9 * w->rate);
+    std::vector<Conn*> touched;
+    while(w->planned < target)
+    {
+        Conn* c = NULL;
+        for(size_t i = 0; i < w->conns.size(); i++)
+        {
+            Conn* cand = &w->conns[(w->next_conn + i) % w->conns.size()];
+            if(cand->connected && (int)cand->inflight.size() < g_opt.depth)
+            {
+                c = cand;
+                w->next_conn = (w->next_conn + i + 1) % w->conns.size();
+                break;
+            }
+        }
+        /* 所有连接都满了，欠下的请求之后再发，延迟仍从计划时间算 */
+        if(c == NULL)
+            break;
+
+        if(c->out.empty())
+            touched.push_back(c);
+        queue_request(c, w->start_ns + (int64_t)(w->planned * 1e9 / w->rate));
+        w->planned++;
+    }
+
+    for(size_t i = 0; i < touched.size(); i++)
+        flush(w, touched[i]);
+}
+
+/* 每100毫秒一次：重连断开的连接，超时的连接断开重连 */
+static void scan_conns(Worker* w, int64_t now)
+{
+    if(now < w->next_scan_ns)
+        return;
+    w->next_scan_ns = now + 100 * 1000000LL;
+
+    int64_t deadline = now - (int64_t)g_opt.timeout_ms * 1000000;
+    for(size_t i = 0; i < w->conns.size(); i++)
+    {
+        Conn* c = &w->conns[i];
+        if(c->fd != -1 && !c->inflight.empty() && c->inflight.front() < deadline)
+        {
+            w->timeouts += c->inflight.size();
+            c->inflight.clear();
+            conn_failed(w, c);
+        }
+        if(c->fd == -1 && !g_stop.load(std::memory_order_relaxed))
+            start_connect(w, c);
+    }
+}
+
+void* worker_proc(void* args)
+{
+    Worker* w = static_cast<Worker*>(args);
+
+    /* 开环时用timerfd每100微秒检查一次该发多少，闭环只需要定时扫描 */
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_interval.tv_nsec = g_opt.rate > 0 ? 100 * 1000 : 10 * 1000000;
+    its.it_value = its.it_interval;
+    timerfd_settime(w->timerfd, 0, &its, NULL);
+    struct epoll_event e;
+    memset(&e, 0, sizeof(e));
+    e.events = EPOLLIN;
+    e.data.u32 = UINT32_MAX;
+    epoll_ctl(w->epollfd, EPOLL_CTL_ADD, w->timerfd, &e);
+
+    for(size_t i = 0; i < w->conns.size(); i++)
+        start_connect(w, &w->conns[i]);
+    w->start_ns = now_ns();
+    w->next_scan_ns = w->start_ns + 100 * 1000000LL;
+
+    struct epoll_event events[1024];
+    while(!g_stop.load(std::memory_order_relaxed))
+    {
+        int n = epoll_wait(w->epollfd, events, 1024, 100);
+        for(int i = 0; i < n; i++)
+        {
+            if(events[i].data.u32 == UINT32_MAX)
+            {
+                uint64_t expirations;
+                if(read(w->timerfd, &expirations, sizeof(expirations)) < 0)
+                    continue;
+                int64_t now = now_ns();
+                if(w->rate > 0)
+                    send_due(w, now);
+                scan_conns(w, now);
+                continue;
+            }
+
+            Conn* c = &w->conns[events[i].data.u32];
+            if(c->fd == -1)
+                continue;
+            if(!c->connected)
+            {
+                if(events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+                    handle_connected(w, c);
+                continue;
+            }
+            if(events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                handle_read(w, c);
+            if(c->fd != -1 && (events[i].events & EPOLLOUT))
+                flush(w, c);
+        }
+    }
+
+    for(size_t i = 0; i < w->conns.size(); i++)
+    {
+        if(w->conns[i].fd != -1)
+            close(w->conns[i].fd);
+    }
+    close(w->timerfd);
+    close(w->epollfd);
+    return NULL;
+}
+
+static std::string make_request(int id)
+{
+    if(g_opt.protocol == PROTO_HTTP)
+        return "GET " + g_opt.path + " HTTP/1.1\r\nHost: " + g_opt.host + "\r\n\r\n";
+
+    char tag[TAG_DIGITS + 3];
+    snprintf(tag, sizeof(tag), "#%0*d#", TAG_DIGITS, id % 10000000);
+    std::string msg = tag;
+    if((int)msg.size() < g_opt.payload - 1)
+        msg.append(g_opt.payload - 1 - msg.size(), 'x');
+    msg += '\n';
+    return msg;
+}
+
+static bool wait_server_ready(double timeout_sec)
+{
+    int64_t deadline = now_ns() + (int64_t)(timeout_sec * 1e9);
+    while(now_ns() < deadline)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        bool ok = connect(fd, (struct sockaddr*)&g_servaddr, sizeof(g_servaddr)) == 0;
+        close(fd);
+        if(ok)
+            return true;
+        usleep(50 * 1000);
+    }
+    return false;
+}
+
+/* 在服务器目录下启动./main，它从./conf读取日志和线程配置，输出丢掉 */
+static pid_t start_server()
+{
+    pid_t pid = fork();
+    if(pid != 0)
+        return pid;
+
+    if(chdir(g_opt.server_dir.c_str()) != 0)
+        _exit(1);
+    int null = open("/dev/null", O_RDWR);
+    if(null != -1)
+    {
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+    }
+
+    char port[16];
+    snprintf(port, sizeof(port), "%d", g_opt.port);
+    std::vector<std::string> args;
+    args.push_back("./main");
+    args.push_back("-p");
+    args.push_back(port);
+    char* save = NULL;
+    std::string extra = g_opt.server_args;
+    for(char* tok = strtok_r(&extra[0], " ", &save); tok != NULL; tok = strtok_r(NULL, " ", &save))
+        args.push_back(tok);
+
+    std::vector<char*> argv;
+    for(size_t i = 0; i < args.size(); i++)
+        argv.push_back(&args[i][0]);
+    argv.push_back(NULL);
+    execv("./main", &argv[0]);
+    _exit(1);
+}
+
+static double percentile(const std::vector<float>& sorted, double p)
+{
+    if(sorted.empty())
+        return 0;
+    size_t index = (size_t)(sorted.size() * p);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static const char* protocol_name(Protocol p)
+{
+    return p == PROTO_HTTP ? "http" : (p == PROTO_CHAT ? "chat" : "echo");
+}
+
+static void raise_fd_limit(int need)
+{
+    struct rlimit rl;
+    if(getrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur >= (rlim_t)need)
+        return;
+    rl.rlim_cur = std::min((rlim_t)need, rl.rlim_max);
+    setrlimit(RLIMIT_NOFILE, &rl);
+}
+
+int main(int argc, char* argv[])
+{
+    int ch;
+    while((ch = getopt(argc, argv, "h:p:P:c:t:d:m:R:s:w:u:T:e:M:n:")) != -1)
+    {
+        switch(ch)
+        {
+            case 'h':
+                g_opt.host = optarg;
+                break;
+            case 'p':
+                g_opt.port = atoi(optarg);
+                break;
+            case 'P':
+                if(strcmp(optarg, "chat") == 0)
+                    g_opt.protocol = PROTO_CHAT;
+                else if(strcmp(optarg, "http") == 0)
+                    g_opt.protocol = PROTO_HTTP;
+                else
+                    g_opt.protocol = PROTO_ECHO;
+                break;
+            case 'c':
+                g_opt.conns = std::max(1, atoi(optarg));
+                break;
+            case 't':
+                g_opt.threads = std::max(1, atoi(optarg));
+                break;
+            case 'd':
+                g_opt.depth = std::max(1, atoi(optarg));
+                break;
+            case 'm':
+                /* 至少放得下编号和换行 */
+                g_opt.payload = std::max(TAG_DIGITS + 3, atoi(optarg));
+                break;
+            case 'R':
+                g_opt.rate = std::max(0.0, atof(optarg));
+                break;
+            case 's':
+                g_opt.seconds = std::max(1, atoi(optarg));
+                break;
+            case 'w':
+                g_opt.warmup = std::max(0, atoi(optarg));
+                break;
+            case 'u':
+                g_opt.path = optarg;
+                break;
+            case 'T':
+                g_opt.timeout_ms = std::max(1, atoi(optarg));
+                break;
+            case 'e':
+                g_opt.server_dir = optarg;
+                break;
+            case 'M':
+                g_opt.server_args = optarg;
+                break;
+            case 'n':
+                g_opt.name = optarg;
+                break;
+        }
+    }
+    if(g_opt.threads > g_opt.conns)
+        g_opt.threads = g_opt.conns;
+
+    struct hostent* he = gethostbyname(g_opt.host.c_str());
+    if(he == NULL || he->h_addrtype != AF_INET)
+    {
+        fprintf(stderr, "cannot resolve %s\n", g_opt.host.c_str());
+        return 1;
+    }
+    memset(&g_servaddr, 0, sizeof(g_servaddr));
+    g_servaddr.sin_family = AF_INET;
+    memcpy(&g_servaddr.sin_addr, he->h_addr_list[0], sizeof(g_servaddr.sin_addr));
+    g_servaddr.sin_port = htons(g_opt.port);
+    signal(SIGPIPE, SIG_IGN);
+    raise_fd_limit(g_opt.conns + 64);
+
+    pid_t server = -1;
+    if(!g_opt.server_dir.empty())
+    {
+        server = start_server();
+        if(server < 0 || !wait_server_ready(3))
+        {
+            fprintf(stderr, "server in %s did not start\n", g_opt.server_dir.c_str());
+            if(server > 0)
+            {
+                kill(server, SIGKILL);
+                waitpid(server, NULL, 0);
+            }
+            return 1;
+        }
+    }
+
+    /* 预热阶段发出的请求不计入结果 */
+    int64_t start = now_ns();
+    g_measure_start = start + (int64_t)g_opt.warmup * 1000000000;
+    g_measure_end = g_measure_start + (int64_t)g_opt.seconds * 1000000000;
+
+    std::vector<Worker> workers(g_opt.threads);
+    for(int i = 0; i < g_opt.conns; i++)
+    {
+        Worker& w = workers[i % g_opt.threads];
+        Conn c;
+        c.id = i;
+        c.request = make_request(i);
+        w.conns.push_back(c);
+    }
+    for(int i = 0; i < g_opt.threads; i++)
+    {
+        Worker& w = workers[i];
+        w.epollfd = epoll_create1(EPOLL_CLOEXEC);
+        w.timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        w.rate = g_opt.rate * w.conns.size() / g_opt.conns;
+        pthread_create(&w.tid, NULL, worker_proc, &w);
+    }
+
+    struct timespec ts;
+    ts.tv_sec = g_opt.warmup + g_opt.seconds;
+    ts.tv_nsec = 0;
+    while(nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+    g_stop = true;
+
+    Worker total;
+    for(int i = 0; i < g_opt.threads; i++)
+    {
+        Worker& w = workers[i];
+        pthread_join(w.tid, NULL);
+        total.latency_us.insert(total.latency_us.end(), w.latency_us.begin(), w.latency_us.end());
+        total.requests += w.requests;
+        total.errors += w.errors;
+        total.timeouts += w.timeouts;
+        total.reconnects += w.reconnects;
+        total.deliveries += w.deliveries;
+        total.bytes_in += w.bytes_in;
+        total.bytes_out += w.bytes_out;
+    }
+
+    if(server > 0)
+    {
+        kill(server, SIGTERM);
+        waitpid(server, NULL, 0);
+    }
+
+    std::vector<float>& lat = total.latency_us;
+    std::sort(lat.begin(), lat.end());
+    double sum = 0;
+    for(size_t i = 0; i < lat.size(); i++)
+        sum += lat[i];
+
+    printf("{\"name\":\"%s\",\"protocol\":\"%s\",\"mode\":\"%s\",\"server_args\":\"%s\","
+            "\"connections\":%d,\"threads\":%d,\"depth\":%d,\"payload\":%d,\"rate\":%.0f,\"seconds\":%d,"
+            "\"requests\":%ld,\"throughput\":%.1f,\"bytes_in\":%llu,\"bytes_out\":%llu,"
+            "\"errors\":%ld,\"timeouts\":%ld,\"reconnects\":%ld,\"deliveries\":%ld,"
+            "\"latency_us\":{\"min\":%.1f,\"mean\":%.1f,\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f}}\n",
+            g_opt.name.c_str(), protocol_name(g_opt.protocol), g_opt.rate > 0 ? "open" : "closed",
+            g_opt.server_args.c_str(), g_opt.conns, g_opt.threads, g_opt.depth,
+            g_opt.protocol == PROTO_HTTP ? 0 : g_opt.payload, g_opt.rate, g_opt.seconds,
+            total.requests, total.requests / (double)g_opt.seconds,
+            (unsigned long long)total.bytes_in, (unsigned long long)total.bytes_out,
+            total.errors, total.timeouts, total.reconnects, total.deliveries,
+            lat.empty() ? 0.0 : lat.front(), lat.empty() ? 0.0 : sum / lat.size(),
+            percentile(lat, 0.50), percentile(lat, 0.90), percentile(lat, 0.99), percentile(lat, 0.999),
+            lat.empty() ? 0.0 : lat.back());
+    return 0;
+}
@@ -0,0 +1,602 @@
+/*
+ * 共享队列模式（MODE_WORKER_QUEUE）下连接归属的压力测试，服务器开多个工作线程，依次跑两个场景：
+ *   http  启动HTTP服务器，多个客户端线程轮流用三种连接压它——
+ *           short     每个请求新建连接，回复之后服务器关闭
+ *           pipeline  一次写出一串请求，再分几段陆续补写，让同一个fd在工作线程处理期间再次就绪
+ *           halfclose 写完请求马上关闭写端，数据和FIN一起到达
+ *   chat  启动聊天服务器，每个客户端发一行、等自己那行被广播回来再发下一行；
+ *         广播用deliver()投递给每个连接，和这些连接自己的读事件交错着分发
+ * 服务器的输出接到管道里，结束前发SIGUSR2让它把统计写进日志。stats_json()中的owner_conflicts不为0、
+ * 日志中有ERROR行、回复数对不上或者读写出错都算失败，失败时退出码为1
+ * 用法：./stress_owner [-p port] [-c 客户端线程数] [-s 每个场景的秒数] [-d 每串的请求数] [-w 工作线程数]
+ *                      [-e HTTP服务器目录] [-g 聊天服务器目录] [-t http|chat]
+ */
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+static const char* g_request = "GET /hello.txt HTTP/1.1\r\nHost: localhost\r\n\r\n";
+static const char* g_close_request = "GET /hello.txt HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+
+static volatile bool g_stop = false;
+static int g_port = 12353;
+static int g_depth = 16;
+static int g_workers = 4;
+
+static double now_sec()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int connect_server(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(fd == -1)
+        return -1;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = htons(port);
+    if(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return fd;
+}
+
+static bool send_all(int fd, const char* data, size_t len)
+{
+    while(len > 0)
+    {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if(n <= 0)
+            return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+/* 被测的服务器进程，标准输出和标准错误接到管道，由reader线程逐行检查 */
+struct Server
+{
+    pid_t pid;
+    int logfd;
+    pthread_t reader;
+    /* 日志中的ERROR行数和第一行的内容 */
+    long error_lines;
+    std::string first_error;
+    /* 最近一次统计中的owner_conflicts，没有收到统计时为-1 */
+    long conflicts;
+};
+
+static void check_log_line(Server* server, const std::string& line)
+{
+    if(line.compare(0, 6, "ERROR ") == 0)
+    {
+        if(server->error_lines++ == 0)
+            server->first_error = line;
+    }
+    size_t pos = line.find("\"owner_conflicts\":");
+    if(pos != std::string::npos)
+        server->conflicts = atol(line.c_str() + pos + strlen("\"owner_conflicts\":"));
+}
+
+static void* log_reader_proc(void* args)
+{
+    Server* server = static_cast<Server*>(args);
+    std::string pending;
+    char buf[65536];
+    ssize_t n;
+    while((n = read(server->logfd, buf, sizeof(buf))) > 0)
+    {
+        pending.append(buf, n);
+        size_t begin = 0, end;
+        while((end = pending.find('\n', begin)) != std::string::npos)
+        {
+            check_log_line(server, pending.substr(begin, end - begin));
+            begin = end + 1;
+        }
+        pending.erase(0, begin);
+    }
+    if(!pending.empty())
+        check_log_line(server, pending);
+    return NULL;
+}
+
+static bool wait_server_ready(int port, double timeout_sec)
+{
+    double deadline = now_sec() + timeout_sec;
+    while(now_sec() < deadline)
+    {
+        int fd = connect_server(port);
+        if(fd != -1)
+        {
+            close(fd);
+            return true;
+        }
+        usleep(50 * 1000);
+    }
+    return false;
+}
+
+/* 在服务器目录下启动./main，不带模式参数就是共享队列模式 */
+static bool start_server(const char* dir, int port, Server* server)
+{
+    server->pid = -1;
+    server->logfd = -1;
+    server->error_lines = 0;
+    server->conflicts = -1;
+
+    int fds[2];
+    if(pipe2(fds, O_CLOEXEC) != 0)
+        return false;
+
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+        if(chdir(dir) != 0)
+            _exit(1);
+        dup2(fds[1], STDOUT_FILENO);
+        dup2(fds[1], STDERR_FILENO);
+        char portstr[16], workerstr[16];
+        snprintf(portstr, sizeof(portstr), "%d", port);
+        snprintf(workerstr, sizeof(workerstr), "%d", g_workers);
+        execl("./main", "./main", "-p", portstr, "-w", workerstr, (char*)NULL);
+        _exit(1);
+    }
+    close(fds[1]);
+    if(pid < 0)
+    {
+        close(fds[0]);
+        return false;
+    }
+    server->pid = pid;
+    server->logfd = fds[0];
+    pthread_create(&server->reader, NULL, log_reader_proc, server);
+
+    if(!wait_server_ready(port, 3))
+    {
+        printf("server in %s did not start\n", dir);
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        pthread_join(server->reader, NULL);
+        close(server->logfd);
+        return false;
+    }
+    return true;
+}
+
+/* 先让服务器把统计写进日志再退出，读完它的全部输出；没有正常退出时返回false */
+static bool stop_server(Server* server)
+{
+    kill(server->pid, SIGUSR2);
+    usleep(300 * 1000);
+    kill(server->pid, SIGTERM);
+
+    int status = 0;
+    double deadline = now_sec() + 5;
+    while(waitpid(server->pid, &status, WNOHANG) == 0)
+    {
+        if(now_sec() > deadline)
+        {
+            kill(server->pid, SIGKILL);
+            waitpid(server->pid, &status, 0);
+            break;
+        }
+        usleep(50 * 1000);
+    }
+    pthread_join(server->reader, NULL);
+    close(server->logfd);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/* 读完一个回复：响应头加上Content-length字节的正文，多读到的留给下一次；状态不是200时算失败 */
+static bool read_http_response(int fd, std::string* pending)
+{
+    while(true)
+    {
+        size_t end = pending->find("\r\n\r\n");
+        if(end != std::string::npos)
+        {
+            size_t body = 0;
+            size_t pos = pending->find("Content-length: ");
+            if(pos != std::string::npos && pos < end)
+                body = atol(pending->c_str() + pos + 16);
+            if(pending->size() >= end + 4 + body)
+            {
+                bool ok = pending->compare(0, 12, "HTTP/1.1 200") == 0;
+                pending->erase(0, end + 4 + body);
+                return ok;
+            }
+        }
+
+        char buf[16384];
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if(n <= 0)
+            return false;
+        pending->append(buf, n);
+    }
+}
+
+/* 服务器回复完Connection: close的请求之后应当关闭连接 */
+static bool read_eof(int fd)
+{
+    char buf[256];
+    return recv(fd, buf, sizeof(buf), 0) == 0;
+}
+
+struct ClientResult
+{
+    long requests;
+    long errors;
+    unsigned seed;
+};
+
+/* 每个请求一个连接 */
+static bool run_short(ClientResult* result)
+{
+    int fd = connect_server(g_port);
+    if(fd == -1)
+        return false;
+    std::string pending;
+    bool ok = send_all(fd, g_close_request, strlen(g_close_request))
+        && read_http_response(fd, &pending) && read_eof(fd);
+    close(fd);
+    if(ok)
+        result->requests++;
+    return ok;
+}
+
+/* 一串请求分几段写出，前一段的回复还没读完就写下一段，最后一个请求要求关闭 */
+static bool run_pipeline(ClientResult* result)
+{
+    int fd = connect_server(g_port);
+    if(fd == -1)
+        return false;
+
+    std::string batch;
+    for(int i = 0; i < g_depth - 1; i++)
+        batch += g_request;
+    batch += g_close_request;
+
+    bool ok = true;
+    size_t sent = 0;
+    while(ok && sent < batch.size())
+    {
+        size_t len = 1 + rand_r(&result->seed) % (batch.size() - sent);
+        ok = send_all(fd, batch.data() + sent, len);
+        sent += len;
+    }
+
+    std::string pending;
+    for(int i = 0; ok && i < g_depth; i++)
+    {
+        ok = read_http_response(fd, &pending);
+        if(ok)
+            result->requests++;
+    }
+    ok = ok && read_eof(fd);
+    close(fd);
+    return ok;
+}
+
+/* 请求和FIN一起到达，服务器回复完已经收到的请求之后关闭 */
+static bool run_halfclose(ClientResult* result)
+{
+    int fd = connect_server(g_port);
+    if(fd == -1)
+        return false;
+
+    std::string batch;
+    int count = 1 + rand_r(&result->seed) % 4;
+    for(int i = 0; i < count; i++)
+        batch += g_request;
+    bool ok = send_all(fd, batch.data(), batch.size()) && shutdown(fd, SHUT_WR) == 0;
+
+    std::string pending;
+    for(int i = 0; ok && i < count; i++)
+    {
+        ok = read_http_response(fd, &pending);
+        if(ok)
+            result->requests++;
+    }
+    ok = ok && read_eof(fd);
+    close(fd);
+    return ok;
+}
+
+void* http_client_proc(void* args)
+{
+    ClientResult* result = static_cast<ClientResult*>(args);
+    for(long round = 0; !g_stop; round++)
+    {
+        bool ok = false;
+        switch(round % 3)
+        {
+            case 0:
+                ok = run_short(result);
+                break;
+            case 1:
+                ok = run_pipeline(result);
+                break;
+            default:
+                ok = run_halfclose(result);
+                break;
+        }
+        if(!ok)
+            result->errors++;
+    }
+    return NULL;
+}
+
+/* 聊天客户端，连接在启动线程之前建立 */
+struct ChatClient
+{
+    int index;
+    int fd;
+    /* 自己发出、已经看到广播回来的最大序号，加入时的那一行是0 */
+    long echoed;
+    long sent;
+    /* 收到的所有客户在加入之后发的行数 */
+    long received;
+    long errors;
+    std::string pending;
+};
+
+static pthread_barrier_t g_chat_barrier;
+static std::atomic<long> g_chat_sent(0);
+
+/* 广播回来的一行是“时间 client<fd> :”加上原来的内容，原来的内容里没有冒号 */
+static void check_chat_line(ChatClient* client, const std::string& line)
+{
+    size_t colon = line.rfind(':');
+    if(colon == std::string::npos)
+        return;
+    const char* msg = line.c_str() + colon + 1;
+    int index = 0;
+    long seq = 0;
+    if(sscanf(msg, "m %d %ld", &index, &seq) == 2)
+    {
+        client->received++;
+        if(index == client->index)
+            client->echoed = seq;
+    }
+    else if(sscanf(msg, "j %d", &index) == 1 && index == client->index)
+        client->echoed = 0;
+}
+
+/* 最多等timeout_ms读一次，收到的完整行交给check_chat_line；超时、出错或者连接被关闭时返回false */
+static bool chat_read(ChatClient* client, int timeout_ms)
+{
+    struct pollfd pfd;
+    pfd.fd = client->fd;
+    pfd.events = POLLIN;
+    if(poll(&pfd, 1, timeout_ms) != 1)
+        return false;
+
+    char buf[65536];
+    ssize_t n = recv(client->fd, buf, sizeof(buf), 0);
+    if(n <= 0)
+        return false;
+    client->pending.append(buf, n);
+
+    size_t begin = 0, end;
+    while((end = client->pending.find('\n', begin)) != std::string::npos)
+    {
+        check_chat_line(client, client->pending.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    client->pending.erase(0, begin);
+    return true;
+}
+
+/* 发一行，等它被广播回自己，其间收到的别人的行照样计数 */
+static bool chat_round(ChatClient* client, const char* line, long seq)
+{
+    if(!send_all(client->fd, line, strlen(line)))
+        return false;
+    double deadline = now_sec() + 3;
+    while(client->echoed != seq)
+    {
+        int left = (int)((deadline - now_sec()) * 1000);
+        if(left <= 0 || !chat_read(client, left))
+            return false;
+    }
+    return true;
+}
+
+void* chat_client_proc(void* args)
+{
+    ChatClient* client = static_cast<ChatClient*>(args);
+    char line[64];
+
+    /* 看到自己加入的那一行说明已经在广播名单里了，所有客户都加入之后才开始计数 */
+    client->echoed = -1;
+    snprintf(line, sizeof(line), "j %d\n", client->index);
+    bool ok = chat_round(client, line, 0);
+    pthread_barrier_wait(&g_chat_barrier);
+    client->received = 0;
+    pthread_barrier_wait(&g_chat_barrier);
+
+    while(ok && !g_stop)
+    {
+        snprintf(line, sizeof(line), "m %d %ld\n", client->index, client->sent + 1);
+        ok = chat_round(client, line, client->sent + 1);
+        if(ok)
+            client->sent++;
+    }
+    g_chat_sent += client->sent;
+
+    /* 每个客户都应当收到所有人发出的每一行 */
+    pthread_barrier_wait(&g_chat_barrier);
+    long total = g_chat_sent.load();
+    double deadline = now_sec() + 5;
+    while(ok && client->received < total)
+    {
+        int left = (int)((deadline - now_sec()) * 1000);
+        ok = left > 0 && chat_read(client, left);
+    }
+    if(!ok || client->received != total)
+        client->errors++;
+    return NULL;
+}
+
+static bool report(const char* name, int nthreads, int seconds, long requests, long errors,
+        const Server& server, bool exited)
+{
+    printf("%s: threads=%d workers=%d seconds=%d requests=%ld errors=%ld owner_conflicts=%ld error_lines=%ld\n",
+            name, nthreads, g_workers, seconds, requests, errors, server.conflicts, server.error_lines);
+    if(server.error_lines > 0)
+        printf("  %s\n", server.first_error.c_str());
+    if(!exited)
+        printf("  server did not exit cleanly\n");
+    return server.conflicts == 0 && server.error_lines == 0 && errors == 0 && requests > 0 && exited;
+}
+
+static bool run_http(const char* dir, int nthreads, int seconds)
+{
+    Server server;
+    if(!start_server(dir, g_port, &server))
+        return false;
+
+    g_stop = false;
+    std::vector<ClientResult> results(nthreads);
+    std::vector<pthread_t> threads(nthreads);
+    for(int i = 0; i < nthreads; i++)
+    {
+        results[i].requests = 0;
+        results[i].errors = 0;
+        results[i].seed = i + 1;
+        pthread_create(&threads[i], NULL, http_client_proc, &results[i]);
+    }
+    sleep(seconds);
+    g_stop = true;
+    for(int i = 0; i < nthreads; i++)
+        pthread_join(threads[i], NULL);
+
+    long requests = 0, errors = 0;
+    for(int i = 0; i < nthreads; i++)
+    {
+        requests += results[i].requests;
+        errors += results[i].errors;
+    }
+    bool exited = stop_server(&server);
+    return report("http", nthreads, seconds, requests, errors, server, exited);
+}
+
+static bool run_chat(const char* dir, int nthreads, int seconds)
+{
+    int port = g_port + 1;
+    Server server;
+    if(!start_server(dir, port, &server))
+        return false;
+
+    std::vector<ChatClient> clients(nthreads);
+    for(int i = 0; i < nthreads; i++)
+    {
+        clients[i].index = i;
+        clients[i].fd = connect_server(port);
+        clients[i].echoed = -1;
+        clients[i].sent = 0;
+        clients[i].received = 0;
+        clients[i].errors = clients[i].fd == -1 ? 1 : 0;
+    }
+
+    g_stop = false;
+    g_chat_sent = 0;
+    pthread_barrier_init(&g_chat_barrier, NULL, nthreads + 1);
+    std::vector<pthread_t> threads(nthreads);
+    for(int i = 0; i < nthreads; i++)
+        pthread_create(&threads[i], NULL, chat_client_proc, &clients[i]);
+    pthread_barrier_wait(&g_chat_barrier);
+    pthread_barrier_wait(&g_chat_barrier);
+    sleep(seconds);
+    g_stop = true;
+    pthread_barrier_wait(&g_chat_barrier);
+    for(int i = 0; i < nthreads; i++)
+        pthread_join(threads[i], NULL);
+    pthread_barrier_destroy(&g_chat_barrier);
+
+    long requests = 0, errors = 0;
+    for(int i = 0; i < nthreads; i++)
+    {
+        requests += clients[i].sent;
+        errors += clients[i].errors;
+        if(clients[i].fd != -1)
+            close(clients[i].fd);
+    }
+    bool exited = stop_server(&server);
+    return report("chat", nthreads, seconds, requests, errors, server, exited);
+}
+
+int main(int argc, char* argv[])
+{
+    int nthreads = 16;
+    int seconds = 5;
+    const char* http_dir = "../MyReactorHTTP";
+    const char* chat_dir = "../MyReactorChat";
+    const char* only = NULL;
+
+    int ch;
+    while((ch = getopt(argc, argv, "p:c:s:d:w:e:g:t:")) != -1)
+    {
+        switch(ch)
+        {
+            case 'p':
+                g_port = atoi(optarg);
+                break;
+            case 'c':
+                nthreads = atoi(optarg) > 0 ? atoi(optarg) : 1;
+                break;
+            case 's':
+                seconds = atoi(optarg);
+                break;
+            case 'd':
+                g_depth = atoi(optarg) > 0 ? atoi(optarg) : 1;
+                break;
+            case 'w':
+                g_workers = atoi(optarg) > 1 ? atoi(optarg) : 2;
+                break;
+            case 'e':
+                http_dir = optarg;
+                break;
+            case 'g':
+                chat_dir = optarg;
+                break;
+            case 't':
+                only = optarg;
+                break;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    bool ok = true;
+    if(only == NULL || strcmp(only, "http") == 0)
+        ok = run_http(http_dir, nthreads, seconds) && ok;
+    if(only == NULL || strcmp(only, "chat") == 0)
+        ok = run_chat(chat_dir, nthreads, seconds) && ok;
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,74 @@
+#include "EchoHandler.h"
+#include "MyReactor.h"
+
+
+EchoHandler::EchoHandler(MyReactor<EchoHandler>* reactor)
+    : m_reactor(reactor)
+{
+}
+
+
+void EchoHandler::set_coroutine(bool on, int delay_ms)
+{
+    m_coroutine = on;
+    m_co_delay_ms = delay_ms > 0 ? delay_ms : 0;
+}
+
+
+void EchoHandler::on_connection(Connection* conn)
+{
+    if(!m_coroutine)
+        return;
+    CoConnection::spawn(conn,
+            [this](Connection* c, int64_t delay_ms) { m_reactor->schedule_wakeup(c->fd(), delay_ms); },
+            [this](CoConnection* io) { return echo_session(io); });
+}
+
+
+void EchoHandler::on_message(Connection* conn, Buffer* buf)
+{
+    LOG_DEBUG("client msg: %.*s", (int)buf->readable_bytes(), buf->peek());
+
+    /* 时间戳直接写在缓冲区的预留区，回显时不必再拷贝一次消息 */
+    buf->prepend(reply_prefix());
+    LOG_DEBUG("send: %.*s\n", (int)buf->readable_bytes(), buf->peek());
+    if(!conn->send(buf))
+        LOG_ERROR("send error, fd = %d\n", conn->fd());
+}
+
+
+void EchoHandler::on_high_water(Connection* conn, size_t len)
+{
+    LOG_INFO("output buffer reaches %d bytes, pause reading fd = %d\n", (int)len, conn->fd());
+    conn->set_reading(false);
+}
+
+
+std::string EchoHandler::reply_prefix()
+{
+    /* 将消息加上时间戳 */
+    time_t now = time(NULL);
+    struct tm* nowstr = localtime(&now);
+    std::ostringstream ostimestr;
+    ostimestr << "[" << nowstr->tm_year + 1900 << "-"
+        << std::setw(2) << std::setfill('0') << nowstr->tm_mon + 1 << "-"
+        << std::setw(2) << std::setfill('0') << nowstr->tm_mday << " "
+        << std::setw(2) << std::setfill('0') << nowstr->tm_hour << ":"
+        << std::setw(2) << std::setfill('0') << nowstr->tm_min << ":"
+        << std::setw(2) << std::setfill('0') << nowstr->tm_sec << "]server reply: ";
+    return ostimestr.str();
+}
+
+
+CoTask EchoHandler::echo_session(CoConnection* io)
+{
+    std::string msg;
+    while(co_await io->read(&msg))
+    {
+        LOG_DEBUG("client msg: %.*s", (int)msg.size(), msg.data());
+        if(m_co_delay_ms > 0 && !co_await io->sleep(m_co_delay_ms))
+            break;
+        if(!co_await io->write(reply_prefix() + msg))
+            break;
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef __ECHOHANDLER_H
+#define __ECHOHANDLER_H
+
+#include <string>
+#include "Connection.h"
+#include "Coroutine.h"
+
+template<typename Handler> class MyReactor;
+
+/* 回显协议：每条消息加上时间戳原样发回 */
+class EchoHandler
+{
+    public:
+        explicit EchoHandler(MyReactor<EchoHandler>* reactor);
+
+        /*
+         * 用协程处理连接：协议按顺序写在echo_session里，每次回复前睡眠delay_ms毫秒模拟慢请求，
+         * 睡眠和等待读写时线程去处理其他连接；需要在init之前调用
+         */
+        void set_coroutine(bool on, int delay_ms);
+
+        bool init() { return true; }
+        void uninit() {}
+        /* 协程模式下在新连接上启动echo_session */
+        void on_connection(Connection* conn);
+        void on_message(Connection* conn, Buffer* buf);
+        /* 对端不读的时候不再读它的请求，积压写出去之后再恢复 */
+        void on_high_water(Connection* conn, size_t len);
+        void on_close(int clientfd) {}
+
+    private:
+        /* 回复前面加的时间戳 */
+        static std::string reply_prefix();
+        CoTask echo_session(CoConnection* io);
+
+    private:
+        MyReactor<EchoHandler>* m_reactor;
+        /* 是否用协程处理连接，以及每次回复前睡眠的毫秒数 */
+        bool m_coroutine = false;
+        int m_co_delay_ms = 0;
+};
+
+#endif
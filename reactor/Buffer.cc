@@ -0,0 +1,109 @@
+#include "Buffer.h"
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <sys/uio.h>
+
+Buffer::Buffer()
+    : m_buf(BUFFER_PREPEND + BUFFER_INIT_SIZE),
+      m_read_index(BUFFER_PREPEND),
+      m_write_index(BUFFER_PREPEND)
+{
+}
+
+void Buffer::retrieve(size_t len)
+{
+    if(len < readable_bytes())
+        m_read_index += len;
+    else
+        retrieve_all();
+}
+
+void Buffer::retrieve_all()
+{
+    m_read_index = BUFFER_PREPEND;
+    m_write_index = BUFFER_PREPEND;
+}
+
+std::string Buffer::retrieve_all_as_string()
+{
+    std::string str(peek(), readable_bytes());
+    retrieve_all();
+    return str;
+}
+
+void Buffer::append(const char* data, size_t len)
+{
+    ensure_writable(len);
+    memcpy(begin_write(), data, len);
+    has_written(len);
+}
+
+void Buffer::prepend(const char* data, size_t len)
+{
+    if(len > prependable_bytes())
+    {
+        /* 数据整体后移，留出len个字节 */
+        size_t readable = readable_bytes();
+        if(m_buf.size() < len + readable)
+            m_buf.resize(len + readable);
+        memmove(&m_buf[0] + len, peek(), readable);
+        m_read_index = len;
+        m_write_index = len + readable;
+    }
+    m_read_index -= len;
+    memcpy(&m_buf[0] + m_read_index, data, len);
+}
+
+const char* Buffer::find(const char* str, size_t len) const
+{
+    const char* end = peek() + readable_bytes();
+    const char* pos = std::search(peek(), end, str, str + len);
+    return pos == end ? NULL : pos;
+}
+
+void Buffer::ensure_writable(size_t len)
+{
+    if(writable_bytes() < len)
+        make_space(len);
+}
+
+void Buffer::make_space(size_t len)
+{
+    /* 前面空出来的加上后面的也不够，只能扩容 */
+    if(writable_bytes() + prependable_bytes() < len + BUFFER_PREPEND)
+    {
+        m_buf.resize(m_write_index + len);
+        return;
+    }
+
+    size_t readable = readable_bytes();
+    memmove(&m_buf[0] + BUFFER_PREPEND, peek(), readable);
+    m_read_index = BUFFER_PREPEND;
+    m_write_index = m_read_index + readable;
+}
+
+ssize_t Buffer::read_fd(int fd, int* saved_errno)
+{
+    /* 可写区小时一次readv也能读很多，又不用给每个连接分配大缓冲区 */
+    char extrabuf[BUFFER_EXTRA_SIZE];
+    struct iovec vec[2];
+    size_t writable = writable_bytes();
+    vec[0].iov_base = begin_write();
+    vec[0].iov_len = writable;
+    vec[1].iov_base = extrabuf;
+    vec[1].iov_len = sizeof(extrabuf);
+    int iovcnt = writable < sizeof(extrabuf) ? 2 : 1;
+
+    ssize_t n = readv(fd, vec, iovcnt);
+    if(n < 0)
+        *saved_errno = errno;
+    else if((size_t)n <= writable)
+        m_write_index += n;
+    else
+    {
+        m_write_index = m_buf.size();
+        append(extrabuf, n - writable);
+    }
+    return n;
+}
@@ -0,0 +1,68 @@
+#ifndef __BUFFER_H
+#define __BUFFER_H
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <sys/types.h>
+
+/* 头部预留的字节数，回复时可以把时间戳等报头直接写在数据前面 */
+#define BUFFER_PREPEND 64
+#define BUFFER_INIT_SIZE 1024
+/* read_fd时栈上额外缓冲区的大小 */
+#define BUFFER_EXTRA_SIZE 65536
+
+/*
+ * 连续的读写缓冲区
+ *
+ * +-------------------+------------------+------------------+
+ * | prependable bytes |  readable bytes  |  writable bytes  |
+ * +-------------------+------------------+------------------+
+ * 0          <=   m_read_index  <=  m_write_index  <=  size()
+ *
+ * 数据可以包含'\0'，空间不够时先把数据挪到前面，仍然不够才扩容。
+ */
+class Buffer
+{
+    public:
+        Buffer();
+
+        size_t readable_bytes() const { return m_write_index - m_read_index; }
+        size_t writable_bytes() const { return m_buf.size() - m_write_index; }
+        size_t prependable_bytes() const { return m_read_index; }
+
+        /* 第一个可读字节 */
+        const char* peek() const { return &m_buf[0] + m_read_index; }
+        char* begin_write() { return &m_buf[0] + m_write_index; }
+
+        /* 取走len个字节 */
+        void retrieve(size_t len);
+        void retrieve_all();
+        std::string retrieve_all_as_string();
+
+        void append(const char* data, size_t len);
+        void append(const std::string& str) { append(str.data(), str.size()); }
+        /* 在可读数据前面插入报头，预留区不够时把数据往后挪 */
+        void prepend(const char* data, size_t len);
+        void prepend(const std::string& str) { prepend(str.data(), str.size()); }
+
+        /* 查找可读区中的字符串，没有时返回NULL */
+        const char* find(const char* str, size_t len) const;
+
+        /* 保证至少有len个可写字节 */
+        void ensure_writable(size_t len);
+        void has_written(size_t len) { m_write_index += len; }
+
+        /* 从fd读一次，超出可写区的部分先放到栈上再追加；返回值和errno同read */
+        ssize_t read_fd(int fd, int* saved_errno);
+
+    private:
+        void make_space(size_t len);
+
+    private:
+        std::vector<char> m_buf;
+        size_t m_read_index;
+        size_t m_write_index;
+};
+
+#endif
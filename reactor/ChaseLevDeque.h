@@ -0,0 +1,148 @@
+#ifndef __CHASELEVDEQUE_H
+#define __CHASELEVDEQUE_H
+
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+/*
+ * Chase-Lev工作窃取双端队列（按Lê等人给出的C11内存序实现）
+ * 只有拥有者线程在底部push/take，后进先出，刚放进去的任务数据还在cache里；
+ * 其他线程在顶部steal，先进先出，偷走的是最早放进去、通常也是最大的那块工作。
+ * 拥有者和窃取者只在只剩最后一个元素时才用CAS竞争。
+ * 元素要能放进std::atomic，一般是指针；数组满了由拥有者扩容，
+ * 旧数组可能还有窃取者在读，留到析构时再释放。
+ */
+template<typename T>
+class ChaseLevDeque
+{
+    public:
+        /* capacity会向上取整为2的幂 */
+        explicit ChaseLevDeque(size_t capacity = 1024)
+        {
+            size_t n = 2;
+            while(n < capacity)
+                n <<= 1;
+            Array* a = new Array(n);
+            m_arrays.push_back(a);
+            m_array.store(a, std::memory_order_relaxed);
+        }
+
+        ~ChaseLevDeque()
+        {
+            for(size_t i = 0; i < m_arrays.size(); i++)
+                delete m_arrays[i];
+        }
+
+        /* 只有拥有者线程可以调用 */
+        void push(T data)
+        {
+            int64_t b = m_bottom.load(std::memory_order_relaxed);
+            int64_t t = m_top.load(std::memory_order_acquire);
+            Array* a = m_array.load(std::memory_order_relaxed);
+            if(b - t > (int64_t)a->mask)
+                a = grow(a, t, b);
+            a->put(b, data);
+            std::atomic_thread_fence(std::memory_order_release);
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+        }
+
+        /* 只有拥有者线程可以调用，取最后放进去的元素 */
+        bool take(T& data)
+        {
+            int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+            Array* a = m_array.load(std::memory_order_relaxed);
+            m_bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = m_top.load(std::memory_order_relaxed);
+
+            if(t > b)
+            {
+                /* 空的 */
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+                return false;
+            }
+
+            data = a->get(b);
+            if(t == b)
+            {
+                /* 只剩一个，和窃取者抢 */
+                bool won = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+                return won;
+            }
+            return true;
+        }
+
+        /* 任意线程都可以调用，取最早放进去的元素；和别人冲突时也返回false */
+        bool steal(T& data)
+        {
+            int64_t t = m_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = m_bottom.load(std::memory_order_acquire);
+            if(t >= b)
+                return false;
+
+            Array* a = m_array.load(std::memory_order_acquire);
+            T x = a->get(t);
+            if(!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return false;
+            data = x;
+            return true;
+        }
+
+        /* 近似的元素个数 */
+        size_t size() const
+        {
+            int64_t b = m_bottom.load(std::memory_order_relaxed);
+            int64_t t = m_top.load(std::memory_order_relaxed);
+            return b > t ? (size_t)(b - t) : 0;
+        }
+
+        bool empty() const { return size() == 0; }
+
+    private:
+        ChaseLevDeque(const ChaseLevDeque& rhs);
+        ChaseLevDeque& operator = (const ChaseLevDeque& rhs);
+
+        struct Array
+        {
+            explicit Array(size_t n) : mask(n - 1), cells(new std::atomic<T>[n]) {}
+            ~Array() { delete[] cells; }
+
+            T get(int64_t i) const { return cells[i & mask].load(std::memory_order_relaxed); }
+            void put(int64_t i, T data) { cells[i & mask].store(data, std::memory_order_relaxed); }
+
+            size_t mask;
+            std::atomic<T>* cells;
+        };
+
+        /* 容量翻倍，把[t, b)搬到新数组 */
+        Array* grow(Array* a, int64_t t, int64_t b)
+        {
+            Array* bigger = new Array((a->mask + 1) * 2);
+            for(int64_t i = t; i < b; i++)
+                bigger->put(i, a->get(i));
+            m_arrays.push_back(bigger);
+            m_array.store(bigger, std::memory_order_release);
+            return bigger;
+        }
+
+    private:
+        static_assert(std::is_trivially_copyable<T>::value, "ChaseLevDeque element must be trivially copyable");
+
+        /* 窃取者改top，拥有者改bottom，分开放避免伪共享 */
+        alignas(CACHE_LINE_SIZE) std::atomic<int64_t> m_top{0};
+        alignas(CACHE_LINE_SIZE) std::atomic<int64_t> m_bottom{0};
+        std::atomic<Array*> m_array;
+        /* 用过的所有数组，只有拥有者访问 */
+        std::vector<Array*> m_arrays;
+};
+
+#endif
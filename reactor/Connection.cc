@@ -0,0 +1,462 @@
+#include "Connection.h"
+#include "ReactorStats.h"
+#include <algorithm>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+
+Connection::Connection(int fd, int epollfd, uint32_t events)
+    : m_fd(fd),
+      m_epollfd(epollfd),
+      m_events(events),
+      m_file_bytes(0),
+      m_high_water_mark(DEFAULT_HIGH_WATER_MARK),
+      m_closing(false),
+      m_inflight_done(0),
+      m_queued_bytes(0),
+      m_peer_closed(false),
+      m_close_after_write(false)
+{
+}
+
+Connection::~Connection()
+{
+    for(size_t i = 0; i < m_files.size(); i++)
+        ::close(m_files[i].fd);
+}
+
+void Connection::set_completion_io(const SubmitSendCallback& send_cb, const SubmitRecvCallback& recv_cb)
+{
+    m_submit_send = send_cb;
+    m_submit_recv = recv_cb;
+}
+
+void Connection::read_input()
+{
+    /* 边沿触发下要读到EAGAIN或者0为止：和数据一起到的FIN不会再触发一次边沿 */
+    while(true)
+    {
+        int saved_errno = 0;
+        ssize_t n = m_input.read_fd(m_fd, &saved_errno);
+        if(n > 0)
+            ReactorStats::add(&ThreadStats::bytes_in, n);
+        /* 对端关闭了写端，先把已经读到的数据交给上层，回复写完再关闭 */
+        else if(n == 0)
+        {
+            m_peer_closed = true;
+            break;
+        }
+        else if(saved_errno == EINTR)
+            continue;
+        else
+        {
+            if(saved_errno != EAGAIN && saved_errno != EWOULDBLOCK)
+                m_closing = true;
+            break;
+        }
+    }
+}
+
+bool Connection::finish_event()
+{
+    if(m_peer_closed && !m_close_after_write && !completion_mode())
+        close_after_write();
+    if(m_closing)
+    {
+        handle_close();
+        return false;
+    }
+    return true;
+}
+
+bool Connection::handle_write()
+{
+    if(!write_output() || m_closing)
+    {
+        handle_close();
+        return false;
+    }
+    return true;
+}
+
+bool Connection::handle_wakeup()
+{
+    if(m_wakeup_cb)
+        m_wakeup_cb(this);
+
+    if(m_closing)
+    {
+        handle_close();
+        return false;
+    }
+    return true;
+}
+
+bool Connection::send(const char* data, size_t len)
+{
+    if(m_closing)
+        return false;
+
+    if(completion_mode())
+        return send(std::make_shared<const std::string>(data, len));
+
+    /* 还有文件没发完，排在它后面 */
+    if(!m_files.empty())
+    {
+        m_files.back().after.append(data, len);
+        m_file_bytes += len;
+        return true;
+    }
+
+    /* 输出缓冲区为空时直接写，写不完的部分才拷贝进去 */
+    size_t written = 0;
+    if(m_output.readable_bytes() == 0)
+    {
+        ssize_t n = ::send(m_fd, data, len, 0);
+        if(n >= 0)
+        {
+            written = n;
+            ReactorStats::add(&ThreadStats::bytes_out, n);
+        }
+        else if(errno != EWOULDBLOCK && errno != EAGAIN && errno != EINTR)
+        {
+            m_closing = true;
+            return false;
+        }
+
+        if(written == len)
+        {
+            if(m_write_complete_cb)
+                m_write_complete_cb(this);
+            return true;
+        }
+    }
+
+    /* 剩下的等socket可写时再发 */
+    size_t old_len = m_output.readable_bytes();
+    m_output.append(data + written, len - written);
+    set_writing(true);
+
+    size_t new_len = m_output.readable_bytes();
+    if(old_len < m_high_water_mark && new_len >= m_high_water_mark && m_high_water_cb)
+        m_high_water_cb(this, new_len);
+    return true;
+}
+
+bool Connection::send(Buffer* buf)
+{
+    bool ok = send(buf->peek(), buf->readable_bytes());
+    buf->retrieve_all();
+    return ok;
+}
+
+bool Connection::send(const std::shared_ptr<const std::string>& msg)
+{
+    if(!completion_mode())
+        return send(msg->data(), msg->size());
+    if(m_closing)
+        return false;
+
+    size_t old_len = m_queued_bytes;
+    /* 还有文件没读完时排在文件后面 */
+    if(!m_files.empty())
+        m_files.back().after.append(*msg);
+    else
+        m_pending.push_back(msg);
+    m_queued_bytes += msg->size();
+    submit_pending();
+
+    if(old_len < m_high_water_mark && m_queued_bytes >= m_high_water_mark && m_high_water_cb)
+        m_high_water_cb(this, m_queued_bytes);
+    return true;
+}
+
+bool Connection::send_file(const std::string& head, int filefd, off_t offset, size_t count)
+{
+    if(m_closing)
+    {
+        ::close(filefd);
+        return false;
+    }
+
+    if(completion_mode())
+    {
+        /* 完成模式下没有sendfile，文件一块一块读进内存，跟在head后面发送 */
+        if(!m_files.empty())
+            m_files.back().after.append(head);
+        else if(!head.empty())
+            m_pending.push_back(std::make_shared<const std::string>(head));
+        m_files.push_back(FileSegment{filefd, offset, count, std::string()});
+        m_queued_bytes += head.size() + count;
+        submit_pending();
+        return !m_closing;
+    }
+
+    if(!m_files.empty())
+    {
+        m_files.back().after.append(head);
+        m_file_bytes += head.size();
+    }
+    else
+        m_output.append(head);
+    m_files.push_back(FileSegment{filefd, offset, count, std::string()});
+    m_file_bytes += count;
+
+    /* 前面还有没写完的数据时已经在等EPOLLOUT，写到的时候一起发 */
+    if(m_events & EPOLLOUT)
+        return true;
+    return write_output();
+}
+
+void Connection::submit_pending()
+{
+    /* 同一时刻只有一组在内核里，后来的数据排在下一组，保证顺序 */
+    if(!m_inflight.empty())
+        return;
+    /* 排队的数据后面是文件时，这一组带上文件的下一块，一组最多读一块 */
+    while(!m_files.empty() && m_pending.size() < MAX_LINKED_SENDS)
+    {
+        ssize_t n = read_file_chunk();
+        if(n < 0)
+            return;
+        if(n > 0)
+            break;
+    }
+    if(m_pending.empty())
+        return;
+
+    if(m_pending.size() <= MAX_LINKED_SENDS)
+        m_inflight.swap(m_pending);
+    else
+    {
+        m_inflight.assign(m_pending.begin(), m_pending.begin() + MAX_LINKED_SENDS);
+        m_pending.erase(m_pending.begin(), m_pending.begin() + MAX_LINKED_SENDS);
+    }
+    m_inflight_done = 0;
+    m_submit_send(this, m_inflight);
+}
+
+ssize_t Connection::read_file_chunk()
+{
+    FileSegment& file = m_files.front();
+    size_t got = 0;
+    if(file.remaining > 0)
+    {
+        std::string data(std::min(file.remaining, (size_t)FILE_READ_CHUNK), '\0');
+        while(got < data.size())
+        {
+            ssize_t n = pread(file.fd, &data[got], data.size() - got, file.offset + got);
+            if(n < 0 && errno == EINTR)
+                continue;
+            if(n <= 0)
+                break;
+            got += n;
+        }
+        /* 文件被截短了，已经发出的长度没法兑现 */
+        if(got < data.size())
+        {
+            m_closing = true;
+            return -1;
+        }
+        file.offset += got;
+        file.remaining -= got;
+        m_pending.push_back(std::make_shared<const std::string>(std::move(data)));
+        if(file.remaining > 0)
+            return got;
+    }
+
+    /* 文件读完了，跟在它后面的数据接着发 */
+    ::close(file.fd);
+    if(!file.after.empty())
+        m_pending.push_back(std::make_shared<const std::string>(std::move(file.after)));
+    m_files.pop_front();
+    return got;
+}
+
+void Connection::append_input(const char* data, size_t len)
+{
+    ReactorStats::add(&ThreadStats::bytes_in, len);
+    m_input.append(data, len);
+}
+
+bool Connection::handle_sent(int res)
+{
+    /* 一段出错或者没写完时，同一组后面的段会以-ECANCELED完成 */
+    if(res < 0 || (size_t)res < m_inflight[m_inflight_done]->size())
+        m_closing = true;
+    if(res > 0)
+        ReactorStats::add(&ThreadStats::bytes_out, res);
+    if(++m_inflight_done < m_inflight.size())
+        return true;
+
+    for(size_t i = 0; i < m_inflight.size(); i++)
+        m_queued_bytes -= m_inflight[i]->size();
+    m_inflight.clear();
+    m_inflight_done = 0;
+
+    if(m_closing)
+    {
+        handle_close();
+        return false;
+    }
+
+    if(!m_pending.empty() || !m_files.empty())
+        submit_pending();
+    else if(m_write_complete_cb)
+        m_write_complete_cb(this);
+
+    /* 读文件出错或者回调里要求关闭 */
+    if(m_closing || ((m_peer_closed || m_close_after_write) && m_inflight.empty()))
+    {
+        m_closing = true;
+        handle_close();
+        return false;
+    }
+    return true;
+}
+
+void Connection::handle_eof()
+{
+    /* 对端只是关闭了写端，已经提交的回复写完之后再关闭 */
+    if(!m_inflight.empty())
+    {
+        m_peer_closed = true;
+        return;
+    }
+    m_closing = true;
+    handle_close();
+}
+
+bool Connection::write_output()
+{
+    while(true)
+    {
+        while(m_output.readable_bytes() > 0)
+        {
+            /* 后面还有文件时告诉内核数据没完，报头不单独成段 */
+            int flags = m_files.empty() ? 0 : MSG_MORE;
+            ssize_t n = ::send(m_fd, m_output.peek(), m_output.readable_bytes(), flags);
+            if(n >= 0)
+            {
+                m_output.retrieve(n);
+                ReactorStats::add(&ThreadStats::bytes_out, n);
+                continue;
+            }
+
+            if(errno == EINTR)
+                continue;
+            /* socket的发送缓冲区满了，等EPOLLOUT再继续 */
+            if(errno == EWOULDBLOCK || errno == EAGAIN)
+            {
+                set_writing(true);
+                return true;
+            }
+
+            m_closing = true;
+            return false;
+        }
+
+        if(m_files.empty())
+            break;
+        int ret = write_file();
+        if(ret < 0)
+            return false;
+        if(ret == 0)
+        {
+            set_writing(true);
+            return true;
+        }
+    }
+
+    /* 写完了就不再关注EPOLLOUT，否则边沿模式下每次重新武装都会醒来 */
+    set_writing(false);
+    if(m_write_complete_cb)
+        m_write_complete_cb(this);
+    if(m_close_after_write)
+        m_closing = true;
+    return true;
+}
+
+int Connection::write_file()
+{
+    FileSegment& file = m_files.front();
+    while(file.remaining > 0)
+    {
+        ssize_t n = sendfile(m_fd, file.fd, &file.offset, file.remaining);
+        if(n > 0)
+        {
+            file.remaining -= n;
+            m_file_bytes -= n;
+            ReactorStats::add(&ThreadStats::bytes_out, n);
+            continue;
+        }
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n < 0 && (errno == EWOULDBLOCK || errno == EAGAIN))
+            return 0;
+
+        /* 出错，或者返回0说明文件被截短了，已经发出的长度没法兑现 */
+        m_closing = true;
+        return -1;
+    }
+
+    /* 文件发完了，跟在它后面的数据接着发 */
+    ::close(file.fd);
+    m_output.append(file.after);
+    m_file_bytes -= file.after.size();
+    m_files.pop_front();
+    return 1;
+}
+
+void Connection::set_reading(bool on)
+{
+    if(on == reading())
+        return;
+    m_events = on ? (m_events | EPOLLIN) : (m_events & ~EPOLLIN);
+    if(completion_mode())
+        m_submit_recv(this, on);
+    else
+        update_events();
+}
+
+void Connection::set_writing(bool on)
+{
+    if(on == ((m_events & EPOLLOUT) != 0))
+        return;
+    m_events = on ? (m_events | EPOLLOUT) : (m_events & ~EPOLLOUT);
+    update_events();
+}
+
+void Connection::update_events()
+{
+    /* EPOLLONESHOT下由持有者处理完之后按events()重新武装，提前MOD会让其他线程拿到它 */
+    if(m_events & EPOLLONESHOT)
+        return;
+
+    struct epoll_event e;
+    e.events = m_events;
+    e.data.fd = m_fd;
+    epoll_ctl(m_epollfd, EPOLL_CTL_MOD, m_fd, &e);
+}
+
+void Connection::close_after_write()
+{
+    m_close_after_write = true;
+    set_reading(false);
+    if(pending_bytes() == 0)
+        m_closing = true;
+}
+
+void Connection::close()
+{
+    handle_close();
+}
+
+void Connection::handle_close()
+{
+    /* 回调中会销毁this，之后不能再访问成员 */
+    CloseCallback cb = m_close_cb;
+    if(cb)
+        cb(this);
+}
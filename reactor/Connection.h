@@ -0,0 +1,184 @@
+#ifndef __CONNECTION_H
+#define __CONNECTION_H
+
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <deque>
+#include <sys/types.h>
+#include "Buffer.h"
+
+/* 输出缓冲区默认的高水位 */
+#define DEFAULT_HIGH_WATER_MARK (64 * 1024 * 1024)
+/* 完成模式下一组链接发送最多的段数，一组必须在同一次io_uring_enter中提交 */
+#define MAX_LINKED_SENDS 64
+/* 完成模式下每次从文件读进内存发送的字节数，大文件不会整个读进内存 */
+#define FILE_READ_CHUNK (1024 * 1024)
+
+class Connection;
+
+/* 读到数据，buf是连接的输入缓冲区，回调里取走已经处理的部分 */
+typedef std::function<void(Connection*, Buffer*)> MessageCallback;
+/* 输出缓冲区里的数据全部写进了socket */
+typedef std::function<void(Connection*)> WriteCompleteCallback;
+/* 输出缓冲区的积压从高水位以下涨到高水位以上，用来做背压 */
+typedef std::function<void(Connection*, size_t)> HighWaterMarkCallback;
+/* 对端关闭或者出错，回调返回后不能再使用这个连接 */
+typedef std::function<void(Connection*)> CloseCallback;
+/* 定时器等在拥有者线程上唤醒这个连接，见handle_wakeup() */
+typedef std::function<void(Connection*)> WakeupCallback;
+
+/* 完成模式下等待发送的数据段，内核写完之前一直持有 */
+typedef std::vector<std::shared_ptr<const std::string> > SendSegments;
+/* 完成模式下由反应堆把segs按顺序链接起来提交发送，每段完成时调用handle_sent() */
+typedef std::function<void(Connection*, const SendSegments&)> SubmitSendCallback;
+/* 完成模式下开始或者停止接收，收到的数据通过append_input()交给连接 */
+typedef std::function<void(Connection*, bool)> SubmitRecvCallback;
+
+/*
+ * 一个客户连接，由反应堆创建和销毁
+ * 同一时刻只有拥有它的线程访问：子反应堆模式下是该子反应堆，
+ * 共享队列模式下是通过EPOLLONESHOT取得归属的工作线程。
+ * 写不完的数据留在输出缓冲区，只在缓冲区非空时关注EPOLLOUT。
+ * 完成模式（io_uring）下连接自己不做系统调用：数据由反应堆读好后交进来，
+ * 发送的数据按段排队，由反应堆链接成一组提交，回调接口和epoll下相同。
+ */
+class Connection
+{
+    public:
+        /* events是注册到epollfd时的事件，带EPOLLONESHOT时由反应堆按events()重新武装 */
+        Connection(int fd, int epollfd, uint32_t events);
+        /* 关闭还没有发完的文件 */
+        ~Connection();
+
+        int fd() const { return m_fd; }
+        uint32_t events() const { return m_events; }
+        Buffer* input() { return &m_input; }
+        Buffer* output() { return &m_output; }
+
+        void set_message_callback(const MessageCallback& cb) { m_message_cb = cb; }
+        const MessageCallback& message_callback() const { return m_message_cb; }
+        void set_write_complete_callback(const WriteCompleteCallback& cb) { m_write_complete_cb = cb; }
+        void set_high_water_mark_callback(const HighWaterMarkCallback& cb, size_t mark)
+        {
+            m_high_water_cb = cb;
+            m_high_water_mark = mark;
+        }
+        void set_close_callback(const CloseCallback& cb) { m_close_cb = cb; }
+        void set_wakeup_callback(const WakeupCallback& cb) { m_wakeup_cb = cb; }
+        /* 上层挂在连接上的状态，随连接一起销毁 */
+        void set_context(const std::shared_ptr<void>& context) { m_context = context; }
+        const std::shared_ptr<void>& context() const { return m_context; }
+        /* 切换到完成模式，需要在收发数据之前调用 */
+        void set_completion_io(const SubmitSendCallback& send_cb, const SubmitRecvCallback& recv_cb);
+        bool completion_mode() const { return (bool)m_submit_send; }
+
+        /*
+         * 可读事件分两步，反应堆在中间自己把数据交给协议：
+         * read_input()读到EAGAIN或者对端关闭为止，出错时标记关闭；
+         * finish_event()在对端关闭了写端时等回复写完再关闭，标记了关闭时调用关闭回调并返回false
+         */
+        void read_input();
+        bool finish_event();
+        /* 可写事件：继续写输出缓冲区，写完后不再关注EPOLLOUT；连接被关闭时返回false */
+        bool handle_write();
+        /* 拥有者线程上的唤醒，调用唤醒回调；连接被关闭时返回false */
+        bool handle_wakeup();
+
+        /* 发送数据，写不完的放进输出缓冲区；出错时返回false，连接在当前事件处理完后关闭 */
+        bool send(const char* data, size_t len);
+        /* 发送buf中的全部可读数据并取走 */
+        bool send(Buffer* buf);
+        /* 发送共享的数据，完成模式下不拷贝，直到写完都持有msg */
+        bool send(const std::shared_ptr<const std::string>& msg);
+        /*
+         * 先发head，再从filefd的offset处发count字节，之后send()的数据排在文件后面
+         * 文件用sendfile在内核里直接拷贝，socket写满时等EPOLLOUT接着发；head带MSG_MORE，和文件开头合成满的段
+         * 连接接管filefd，发完或者连接关闭时关掉；完成模式下前面的发送完成后每次读一块进内存再发送
+         */
+        bool send_file(const std::string& head, int filefd, off_t offset, size_t count);
+        /* 已经交给连接、还没有写进socket的字节数 */
+        size_t pending_bytes() const { return completion_mode() ? m_queued_bytes : m_output.readable_bytes() + m_file_bytes; }
+
+        /* 完成模式：把收到的数据放进输入缓冲区，之后和read_input()一样由反应堆交给协议 */
+        void append_input(const char* data, size_t len);
+        /* 完成模式：一段发送完成，res是内核的返回值；连接被关闭时返回false */
+        bool handle_sent(int res);
+        /* 完成模式：对端关闭了写端，正在发送的数据写完后关闭 */
+        void handle_eof();
+
+        /* 暂停/恢复关注EPOLLIN，用于背压 */
+        void set_reading(bool on);
+        bool reading() const { return (m_events & EPOLLIN) != 0; }
+
+        /* send()出错后由调用者关闭连接，调用关闭回调 */
+        bool closing() const { return m_closing; }
+        void close();
+        /* 在回调中要求关闭，当前事件处理完后由finish_event()等关闭 */
+        void close_later() { m_closing = true; }
+        /* 不再读新的数据，已经交给连接的数据全部写进socket之后关闭 */
+        void close_after_write();
+
+    private:
+        Connection(const Connection& rhs);
+        Connection& operator = (const Connection& rhs);
+
+        /* 尽量把输出缓冲区和排队的文件写进socket，出错时返回false */
+        bool write_output();
+        /* 发送排在最前面的文件，发完返回1，socket写满返回0，出错返回-1 */
+        int write_file();
+        void set_writing(bool on);
+        void update_events();
+        void handle_close();
+        /* 完成模式：没有正在发送的一组时提交排队的数据段，排在后面的文件每组带上一块 */
+        void submit_pending();
+        /* 完成模式：读第一个文件的下一块排进m_pending，文件读完时排上跟在后面的数据；返回读到的字节数，文件被截短时返回-1 */
+        ssize_t read_file_chunk();
+
+    private:
+        int m_fd;
+        int m_epollfd;
+        uint32_t m_events;
+        Buffer m_input;
+        Buffer m_output;
+        /* 排在输出缓冲区（完成模式下是已经排队的数据段）后面的文件，每个文件之后还有跟在它后面send()的数据 */
+        struct FileSegment
+        {
+            int fd;
+            off_t offset;
+            size_t remaining;
+            std::string after;
+        };
+        std::deque<FileSegment> m_files;
+        /* m_files中文件还没发的字节数加上跟在后面的数据 */
+        size_t m_file_bytes;
+        size_t m_high_water_mark;
+        /* 出错或者被要求关闭，等事件处理完再调用关闭回调 */
+        bool m_closing;
+
+        MessageCallback m_message_cb;
+        WriteCompleteCallback m_write_complete_cb;
+        HighWaterMarkCallback m_high_water_cb;
+        CloseCallback m_close_cb;
+        WakeupCallback m_wakeup_cb;
+
+        /* 完成模式下排队和已经提交的数据段，m_queued_bytes是两者的总字节数 */
+        SubmitSendCallback m_submit_send;
+        SubmitRecvCallback m_submit_recv;
+        SendSegments m_pending;
+        SendSegments m_inflight;
+        size_t m_inflight_done;
+        size_t m_queued_bytes;
+        /* 对端关闭了写端：完成模式下等正在发送的一组完成，epoll下等输出写完 */
+        bool m_peer_closed;
+        /* close_after_write()之后，输出写完就关闭 */
+        bool m_close_after_write;
+
+        /* 最后声明，最先销毁，上层状态析构时连接的其他成员都还在 */
+        std::shared_ptr<void> m_context;
+};
+
+#endif
@@ -0,0 +1,174 @@
+#include "Coroutine.h"
+#include "TimerWheel.h"
+#include <algorithm>
+
+void CoConnection::spawn(Connection* conn, const ScheduleWakeup& schedule, const Session& session)
+{
+    std::shared_ptr<CoConnection> io = std::make_shared<CoConnection>(conn, schedule);
+    CoConnection* p = io.get();
+    conn->set_context(io);
+
+    /* 回调里的p和连接同生共死，连接销毁时context随之销毁 */
+    conn->set_message_callback([p](Connection*, Buffer*) { p->on_event(); });
+    conn->set_write_complete_callback([p](Connection*) { p->on_event(); });
+    conn->set_wakeup_callback([p](Connection*) { p->on_wakeup(); });
+
+    p->m_task = session(p).release();
+    p->m_waiter = p->m_task;
+    p->resume();
+}
+
+CoConnection::CoConnection(Connection* conn, const ScheduleWakeup& schedule)
+    : m_conn(conn),
+      m_schedule(schedule),
+      m_wait(WAIT_NONE),
+      m_result(false),
+      m_out(NULL),
+      m_max(0),
+      m_wake_ms(0)
+{
+}
+
+CoConnection::~CoConnection()
+{
+    /* 挂起中的协程在这里析构它的局部变量 */
+    if(m_task)
+        m_task.destroy();
+}
+
+CoConnection::Awaiter CoConnection::read(std::string* out, size_t max)
+{
+    m_wait = WAIT_READ;
+    m_out = out;
+    m_max = max;
+    return Awaiter(this);
+}
+
+CoConnection::Awaiter CoConnection::read_until(const std::string& delim, std::string* out, size_t limit)
+{
+    m_wait = WAIT_READ_UNTIL;
+    m_out = out;
+    m_delim = delim;
+    m_max = limit;
+    return Awaiter(this);
+}
+
+CoConnection::Awaiter CoConnection::write(const char* data, size_t len)
+{
+    /* 写完的回调在send里同步调用时协程还没挂起，on_event不会恢复它 */
+    m_wait = WAIT_WRITE;
+    if(!m_conn->send(data, len))
+        m_conn->close_later();
+    return Awaiter(this);
+}
+
+CoConnection::Awaiter CoConnection::sleep(int64_t ms)
+{
+    m_wait = WAIT_SLEEP;
+    m_wake_ms = TimerWheel::now_ms() + ms;
+    if(ms > 0)
+        m_schedule(m_conn, ms);
+    return Awaiter(this);
+}
+
+bool CoConnection::finish(bool result)
+{
+    m_wait = WAIT_NONE;
+    m_result = result;
+    return true;
+}
+
+bool CoConnection::poll()
+{
+    Buffer* input = m_conn->input();
+    switch(m_wait)
+    {
+        case WAIT_NONE:
+            return true;
+
+        case WAIT_READ:
+            if(input->readable_bytes() > 0)
+            {
+                size_t n = std::min(m_max, input->readable_bytes());
+                m_out->assign(input->peek(), n);
+                input->retrieve(n);
+                return finish(true);
+            }
+            break;
+
+        case WAIT_READ_UNTIL:
+        {
+            const char* pos = input->find(m_delim.data(), m_delim.size());
+            if(pos != NULL)
+            {
+                size_t n = pos - input->peek() + m_delim.size();
+                m_out->assign(input->peek(), n);
+                input->retrieve(n);
+                return finish(true);
+            }
+            if(input->readable_bytes() > m_max)
+                return finish(false);
+            break;
+        }
+
+        case WAIT_WRITE:
+            if(m_conn->closing())
+                return finish(false);
+            if(m_conn->pending_bytes() == 0)
+                return finish(true);
+            break;
+
+        case WAIT_SLEEP:
+            if(TimerWheel::now_ms() >= m_wake_ms)
+                return finish(true);
+            break;
+    }
+
+    /* 正在关闭的连接不会再有回调，不能挂起 */
+    if(m_conn->closing())
+        return finish(false);
+    /* 等读时确保在读，之前可能因为积压暂停过 */
+    if((m_wait == WAIT_READ || m_wait == WAIT_READ_UNTIL) && !m_conn->reading())
+        m_conn->set_reading(true);
+    return false;
+}
+
+void CoConnection::on_event()
+{
+    if(m_waiter && poll())
+    {
+        resume();
+        return;
+    }
+
+    /* 协程忙着写或睡眠时对端还在发，积压太多就先不读 */
+    if(m_wait != WAIT_READ && m_wait != WAIT_READ_UNTIL
+            && m_conn->input()->readable_bytes() > CO_INPUT_HIGH_WATER && m_conn->reading())
+        m_conn->set_reading(false);
+}
+
+void CoConnection::on_wakeup()
+{
+    /* 定时器按毫秒取整，早到时补上剩下的时间 */
+    if(m_wait == WAIT_SLEEP)
+    {
+        int64_t left = m_wake_ms - TimerWheel::now_ms();
+        if(left > 0)
+        {
+            m_schedule(m_conn, left);
+            return;
+        }
+    }
+    on_event();
+}
+
+void CoConnection::resume()
+{
+    std::coroutine_handle<> h = m_waiter;
+    m_waiter = nullptr;
+    h.resume();
+
+    /* 协程结束了，当前事件处理完后关闭连接 */
+    if(m_task.done())
+        m_conn->close_later();
+}
@@ -0,0 +1,146 @@
+#ifndef __COROUTINE_H
+#define __COROUTINE_H
+
+#include <stdint.h>
+#include <coroutine>
+#include <functional>
+#include <memory>
+#include <string>
+#include "Connection.h"
+
+/* 协程没有在等读的时候，输入缓冲区积压超过这个字节数就暂停读 */
+#define CO_INPUT_HIGH_WATER (1024 * 1024)
+/* read_until默认最多缓存的字节数 */
+#define CO_READ_UNTIL_LIMIT (64 * 1024)
+
+/*
+ * 连接上的协程，返回CoTask的函数里可以co_await CoConnection的读写和睡眠
+ * 创建时先挂起，由CoConnection在拥有者线程上启动；结束时也挂起，帧由CoConnection销毁
+ */
+class CoTask
+{
+    public:
+        struct promise_type
+        {
+            CoTask get_return_object() { return CoTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            void return_void() {}
+            /* 反应堆不使用异常 */
+            void unhandled_exception() { std::terminate(); }
+        };
+
+        CoTask(CoTask&& rhs) : m_handle(rhs.m_handle) { rhs.m_handle = nullptr; }
+        ~CoTask()
+        {
+            if(m_handle)
+                m_handle.destroy();
+        }
+
+        /* 交出协程帧，之后由调用者负责销毁 */
+        std::coroutine_handle<> release()
+        {
+            std::coroutine_handle<> h = m_handle;
+            m_handle = nullptr;
+            return h;
+        }
+
+    private:
+        explicit CoTask(std::coroutine_handle<promise_type> h) : m_handle(h) {}
+        CoTask(const CoTask& rhs);
+        CoTask& operator = (const CoTask& rhs);
+
+    private:
+        std::coroutine_handle<promise_type> m_handle;
+};
+
+
+class CoConnection;
+
+/* delay_ms毫秒后在连接的拥有者线程上调用conn->handle_wakeup() */
+typedef std::function<void(Connection*, int64_t)> ScheduleWakeup;
+/* 一个连接上的协程，参数是包装好的连接 */
+typedef std::function<CoTask(CoConnection*)> Session;
+
+/*
+ * 把Connection包装成可以co_await的读写接口，协议代码可以按顺序写，线程不阻塞
+ * 同一时刻只有一个等待：协程挂起后，由连接的消息、写完、唤醒回调检查等待的条件，满足时恢复协程。
+ * 这些回调都在连接的拥有者线程上调用，协程总是在拥有者线程上运行，不需要加锁。
+ * 每个等待返回false表示连接出错或正在关闭，协程应当co_return；协程结束后连接在当前事件处理完后关闭。
+ * 协程里不要直接调用conn->close()，它会在协程还在运行时销毁协程帧。
+ * CoConnection挂在Connection的context上，连接销毁时挂起中的协程帧一起销毁。
+ */
+class CoConnection
+{
+    public:
+        /* co_await得到bool，见上面 */
+        class Awaiter
+        {
+            public:
+                explicit Awaiter(CoConnection* io) : m_io(io) {}
+                bool await_ready() { return m_io->poll(); }
+                void await_suspend(std::coroutine_handle<> h) { m_io->m_waiter = h; }
+                bool await_resume() { return m_io->m_result; }
+
+            private:
+                CoConnection* m_io;
+        };
+
+        /* 在conn上创建协程并运行到第一次等待，需要在拥有者线程上、收发数据之前调用 */
+        static void spawn(Connection* conn, const ScheduleWakeup& schedule, const Session& session);
+
+        CoConnection(Connection* conn, const ScheduleWakeup& schedule);
+        ~CoConnection();
+
+        Connection* conn() { return m_conn; }
+
+        /* 等到有数据，把输入缓冲区里最多max个字节放进out */
+        Awaiter read(std::string* out, size_t max = (size_t)-1);
+        /* 等到读到delim，连同delim放进out；找到之前已经缓存了超过limit字节时返回false */
+        Awaiter read_until(const std::string& delim, std::string* out, size_t limit = CO_READ_UNTIL_LIMIT);
+        /* 发送数据，等它全部写进socket */
+        Awaiter write(const char* data, size_t len);
+        Awaiter write(const std::string& data) { return write(data.data(), data.size()); }
+        /* 睡眠ms毫秒，期间线程去处理其他连接 */
+        Awaiter sleep(int64_t ms);
+
+    private:
+        CoConnection(const CoConnection& rhs);
+        CoConnection& operator = (const CoConnection& rhs);
+
+        enum WaitKind
+        {
+            WAIT_NONE,
+            WAIT_READ,
+            WAIT_READ_UNTIL,
+            WAIT_WRITE,
+            WAIT_SLEEP
+        };
+
+        /* 当前等待的条件满足时设置m_result并返回true */
+        bool poll();
+        bool finish(bool result);
+        /* 连接的回调：条件满足就恢复协程 */
+        void on_event();
+        void on_wakeup();
+        void resume();
+
+    private:
+        Connection* m_conn;
+        ScheduleWakeup m_schedule;
+        /* 协程帧，结束之后也保留到连接销毁 */
+        std::coroutine_handle<> m_task;
+        /* 挂起中的协程，没有等待时为空 */
+        std::coroutine_handle<> m_waiter;
+
+        WaitKind m_wait;
+        bool m_result;
+        std::string* m_out;
+        /* read的最大字节数，read_until的缓存上限 */
+        size_t m_max;
+        std::string m_delim;
+        /* 睡眠到期的时间，单调时钟毫秒 */
+        int64_t m_wake_ms;
+};
+
+#endif
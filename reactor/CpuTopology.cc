@@ -0,0 +1,119 @@
+#include "CpuTopology.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+CpuTopology::CpuTopology()
+    : m_node_count(1)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for(int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            if(CPU_ISSET(cpu, &set))
+                m_cpus.push_back(cpu);
+    }
+    if(m_cpus.empty())
+    {
+        for(int cpu = 0; cpu < online_cpus(); cpu++)
+            m_cpus.push_back(cpu);
+    }
+
+    load_nodes();
+}
+
+int CpuTopology::online_cpus()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+int CpuTopology::node_of(int cpu) const
+{
+    if(cpu < 0 || cpu >= (int)m_node.size())
+        return 0;
+    return m_node[cpu];
+}
+
+void CpuTopology::load_nodes()
+{
+    m_node.assign(CPU_SETSIZE, 0);
+
+    DIR* dir = opendir("/sys/devices/system/node");
+    if(dir == NULL)
+        return;
+
+    int max_node = 0;
+    struct dirent* entry;
+    while((entry = readdir(dir)) != NULL)
+    {
+        int node;
+        if(sscanf(entry->d_name, "node%d", &node) != 1)
+            continue;
+
+        /* cpulist的格式如 0-3,8-11 */
+        std::string path = std::string("/sys/devices/system/node/") + entry->d_name + "/cpulist";
+        std::ifstream fs(path.c_str());
+        std::string line;
+        if(!std::getline(fs, line))
+            continue;
+
+        std::stringstream ss(line);
+        std::string range;
+        while(std::getline(ss, range, ','))
+        {
+            int lo, hi;
+            int n = sscanf(range.c_str(), "%d-%d", &lo, &hi);
+            if(n < 1)
+                continue;
+            if(n == 1)
+                hi = lo;
+            for(int cpu = lo; cpu <= hi && cpu < CPU_SETSIZE; cpu++)
+                m_node[cpu] = node;
+        }
+        if(node > max_node)
+            max_node = node;
+    }
+    closedir(dir);
+
+    m_node_count = max_node + 1;
+}
+
+std::vector<int> CpuTopology::placement(bool spread) const
+{
+    /* 按节点分组，节点内保持CPU编号顺序 */
+    std::vector<std::vector<int> > by_node(m_node_count);
+    for(size_t i = 0; i < m_cpus.size(); i++)
+        by_node[node_of(m_cpus[i])].push_back(m_cpus[i]);
+
+    std::vector<int> order;
+    if(!spread)
+    {
+        for(size_t n = 0; n < by_node.size(); n++)
+            order.insert(order.end(), by_node[n].begin(), by_node[n].end());
+        return order;
+    }
+
+    for(size_t k = 0; order.size() < m_cpus.size(); k++)
+    {
+        for(size_t n = 0; n < by_node.size(); n++)
+            if(k < by_node[n].size())
+                order.push_back(by_node[n][k]);
+    }
+    return order;
+}
+
+bool CpuTopology::pin(pthread_t thread, int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
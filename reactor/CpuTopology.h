@@ -0,0 +1,44 @@
+#ifndef __CPUTOPOLOGY_H
+#define __CPUTOPOLOGY_H
+
+#include <pthread.h>
+#include <vector>
+
+/*
+ * 本进程可用的CPU以及它们所在的NUMA节点
+ * CPU取自sched_getaffinity，taskset和cgroup限制之外的CPU不会出现；
+ * NUMA节点从/sys/devices/system/node下各节点的cpulist读取，读不到时都算作节点0。
+ */
+class CpuTopology
+{
+    public:
+        CpuTopology();
+
+        /* 可用的CPU个数 */
+        int cpu_count() const { return (int)m_cpus.size(); }
+        int node_count() const { return m_node_count; }
+        int node_of(int cpu) const;
+
+        /*
+         * 给线程分配CPU的顺序
+         * spread为false时先排满一个节点再排下一个，共享数据的线程留在同一个节点；
+         * spread为true时在各节点之间轮流，互相独立的子反应堆平均分到各个节点。
+         */
+        std::vector<int> placement(bool spread) const;
+
+        /* 把线程绑定到一个CPU上 */
+        static bool pin(pthread_t thread, int cpu);
+        /* sysconf(_SC_NPROCESSORS_ONLN)，至少为1 */
+        static int online_cpus();
+
+    private:
+        void load_nodes();
+
+    private:
+        std::vector<int> m_cpus;
+        /* 以CPU编号为下标的节点号 */
+        std::vector<int> m_node;
+        int m_node_count;
+};
+
+#endif
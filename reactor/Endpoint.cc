@@ -0,0 +1,124 @@
+#include "Endpoint.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+bool Endpoint::parse(const std::string& spec)
+{
+    m_spec = spec;
+    memset(&m_addr, 0, sizeof(m_addr));
+
+    /* 最后一个逗号之后是选项组的名字，unix socket的路径里不能有逗号 */
+    size_t comma = spec.rfind(',');
+    m_profile = comma == std::string::npos ? std::string() : spec.substr(comma + 1);
+    if(comma != std::string::npos)
+        return !m_profile.empty() && parse_address(spec.substr(0, comma));
+    return parse_address(spec);
+}
+
+bool Endpoint::parse_address(const std::string& spec)
+{
+    if(spec.compare(0, 5, "unix:") == 0)
+    {
+        std::string name = spec.substr(5);
+        struct sockaddr_un* un = (struct sockaddr_un*)&m_addr;
+        /* 抽象命名空间的名字不以'\0'结尾，sun_path里也放不下结尾的'\0' */
+        if(name.empty() || name.size() >= sizeof(un->sun_path))
+            return false;
+        un->sun_family = AF_UNIX;
+        memcpy(un->sun_path, name.data(), name.size());
+        if(name[0] == '@')
+        {
+            un->sun_path[0] = '\0';
+            m_addrlen = offsetof(struct sockaddr_un, sun_path) + name.size();
+        }
+        else
+            m_addrlen = sizeof(struct sockaddr_un);
+        return true;
+    }
+
+    /* 端口在最后一个冒号之后，IPv6地址在方括号里 */
+    size_t colon = spec.rfind(':');
+    if(colon == std::string::npos || colon + 1 == spec.size())
+        return false;
+    std::string host = spec.substr(0, colon);
+    int port = atoi(spec.c_str() + colon + 1);
+    if(port <= 0 || port > 65535)
+        return false;
+
+    if(host.size() >= 2 && host[0] == '[' && host[host.size() - 1] == ']')
+    {
+        struct sockaddr_in6* in6 = (struct sockaddr_in6*)&m_addr;
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(port);
+        if(inet_pton(AF_INET6, host.substr(1, host.size() - 2).c_str(), &in6->sin6_addr) != 1)
+            return false;
+        m_addrlen = sizeof(struct sockaddr_in6);
+        return true;
+    }
+
+    struct sockaddr_in* in = (struct sockaddr_in*)&m_addr;
+    in->sin_family = AF_INET;
+    in->sin_port = htons(port);
+    if(inet_pton(AF_INET, host.c_str(), &in->sin_addr) != 1)
+        return false;
+    m_addrlen = sizeof(struct sockaddr_in);
+    return true;
+}
+
+std::string Endpoint::inet(const char* ip, int port)
+{
+    std::string host = strchr(ip, ':') != NULL ? std::string("[") + ip + "]" : std::string(ip);
+    return host + ":" + std::to_string(port);
+}
+
+std::string Endpoint::path() const
+{
+    const struct sockaddr_un* un = (const struct sockaddr_un*)&m_addr;
+    if(family() != AF_UNIX || un->sun_path[0] == '\0')
+        return std::string();
+    return std::string(un->sun_path);
+}
+
+void Endpoint::remove_socket_file() const
+{
+    std::string file = path();
+    struct stat st;
+    if(!file.empty() && lstat(file.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(file.c_str());
+}
+
+int Endpoint::listen_socket(int backlog, bool reuseport) const
+{
+    int listenfd = socket(family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(listenfd == -1)
+        return -1;
+
+    int on = 1;
+    if(family() == AF_UNIX)
+    {
+        /* 上次退出时没有删掉的socket文件会让bind失败；同名的其他文件留着，bind报错 */
+        remove_socket_file();
+    }
+    else
+    {
+        setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, (char *)&on, sizeof(on));
+        if(reuseport)
+            setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT, (char *)&on, sizeof(on));
+        /* 不接管IPv4，同一个端口还可以再监听一个IPv4地址 */
+        if(family() == AF_INET6)
+            setsockopt(listenfd, IPPROTO_IPV6, IPV6_V6ONLY, (char *)&on, sizeof(on));
+    }
+
+    if(bind(listenfd, addr(), addrlen()) == -1 || listen(listenfd, backlog) == -1)
+    {
+        close(listenfd);
+        return -1;
+    }
+    return listenfd;
+}
@@ -0,0 +1,50 @@
+#ifndef __ENDPOINT_H
+#define __ENDPOINT_H
+
+#include <string>
+#include <sys/socket.h>
+
+/*
+ * 一个监听地址，写法：
+ *   0.0.0.0:12345       IPv4
+ *   [::]:12345          IPv6，只接受IPv6，可以和同端口的IPv4地址一起监听
+ *   unix:/tmp/echo.sock 路径形式的unix socket，绑定前删掉残留的socket文件
+ *   unix:@echo          Linux抽象命名空间的unix socket，不在文件系统中出现
+ * 后面可以加“,名字”选用conf/socket.conf里的一组socket选项，比如127.0.0.1:12345,latency
+ * 同一台机器上的客户用unix socket可以绕过整个TCP协议栈
+ */
+class Endpoint
+{
+    public:
+        /* 格式不对或者unix路径太长时返回false */
+        bool parse(const std::string& spec);
+        /* ip:port的写法，IPv6地址加上方括号 */
+        static std::string inet(const char* ip, int port);
+
+        const std::string& spec() const { return m_spec; }
+        /* 选用的socket选项组，没有指定时为空 */
+        const std::string& profile() const { return m_profile; }
+        int family() const { return m_addr.ss_family; }
+        const struct sockaddr* addr() const { return (const struct sockaddr*)&m_addr; }
+        socklen_t addrlen() const { return m_addrlen; }
+        /* TCP地址可以每个子反应堆各自用SO_REUSEPORT绑定一个，unix socket只能绑定一次 */
+        bool reuseport() const { return family() != AF_UNIX; }
+        /* 文件系统中的路径，抽象命名空间和TCP地址返回空串 */
+        std::string path() const;
+        /* 删除path()处残留的socket文件；不是socket时不动它，比如配置写错指向了普通文件 */
+        void remove_socket_file() const;
+
+        /* 创建非阻塞的监听socket，失败时返回-1 */
+        int listen_socket(int backlog, bool reuseport) const;
+
+    private:
+        /* 去掉选项组名字之后的地址部分 */
+        bool parse_address(const std::string& spec);
+
+        std::string m_spec;
+        std::string m_profile;
+        struct sockaddr_storage m_addr;
+        socklen_t m_addrlen = 0;
+};
+
+#endif
@@ -0,0 +1,253 @@
+#include "IoUring.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static int io_uring_setup(unsigned entries, struct io_uring_params* p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t argsz)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+
+IoUring::IoUring()
+    : m_fd(-1),
+      m_sq_head(NULL), m_sq_tail(NULL), m_sq_mask(0), m_sq_array(NULL), m_sq_entries(0),
+      m_sqes(NULL), m_sqe_head(0), m_sqe_tail(0),
+      m_cq_head(NULL), m_cq_tail(NULL), m_cq_mask(0), m_cqes(NULL),
+      m_sq_ptr(MAP_FAILED), m_sq_size(0), m_cq_ptr(MAP_FAILED), m_cq_size(0), m_sqes_size(0)
+{
+}
+
+IoUring::~IoUring()
+{
+    release();
+}
+
+void IoUring::release()
+{
+    if(m_sqes != NULL)
+        munmap(m_sqes, m_sqes_size);
+    if(m_cq_ptr != MAP_FAILED && m_cq_ptr != m_sq_ptr)
+        munmap(m_cq_ptr, m_cq_size);
+    if(m_sq_ptr != MAP_FAILED)
+        munmap(m_sq_ptr, m_sq_size);
+    if(m_fd != -1)
+        close(m_fd);
+
+    m_sqes = NULL;
+    m_sq_ptr = m_cq_ptr = MAP_FAILED;
+    m_fd = -1;
+}
+
+bool IoUring::init(unsigned entries, unsigned cq_factor)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    /* 完成时的task work推迟到下一次io_uring_enter，不打断正在处理事件的线程 */
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SUBMIT_ALL;
+    p.cq_entries = entries * cq_factor;
+    m_fd = io_uring_setup(entries, &p);
+    if(m_fd == -1 && errno == EINVAL)
+    {
+        /* 老内核不认识后两个标志 */
+        memset(&p, 0, sizeof(p));
+        p.flags = IORING_SETUP_CQSIZE;
+        p.cq_entries = entries * cq_factor;
+        m_fd = io_uring_setup(entries, &p);
+    }
+    if(m_fd == -1)
+        return false;
+
+    m_sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    m_cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    /* 5.4以后两个队列共用一次mmap */
+    if(p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if(m_cq_size > m_sq_size)
+            m_sq_size = m_cq_size;
+        m_cq_size = m_sq_size;
+    }
+
+    m_sq_ptr = mmap(NULL, m_sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+    if(m_sq_ptr == MAP_FAILED)
+    {
+        release();
+        return false;
+    }
+    if(p.features & IORING_FEAT_SINGLE_MMAP)
+        m_cq_ptr = m_sq_ptr;
+    else
+    {
+        m_cq_ptr = mmap(NULL, m_cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+        if(m_cq_ptr == MAP_FAILED)
+        {
+            release();
+            return false;
+        }
+    }
+
+    m_sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(NULL, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+    if(sqes == MAP_FAILED)
+    {
+        release();
+        return false;
+    }
+    m_sqes = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(m_sq_ptr);
+    m_sq_head = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    m_sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    m_sq_mask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    m_sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    m_sq_entries = p.sq_entries;
+    m_sqe_head = m_sqe_tail = *m_sq_tail;
+
+    char* cq = static_cast<char*>(m_cq_ptr);
+    m_cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    m_cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    m_cq_mask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<struct io_uring_cqe*>(cq + p.cq_off.cqes);
+    return true;
+}
+
+unsigned IoUring::sq_space() const
+{
+    unsigned head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+    return m_sq_entries - (m_sqe_tail - head);
+}
+
+struct io_uring_sqe* IoUring::get_sqe()
+{
+    if(sq_space() == 0)
+    {
+        submit();
+        if(sq_space() == 0)
+            return NULL;
+    }
+
+    struct io_uring_sqe* sqe = &m_sqes[m_sqe_tail & m_sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    m_sqe_tail++;
+    return sqe;
+}
+
+int IoUring::submit(unsigned wait_nr, int timeout_ms)
+{
+    /* 把填好的提交项按顺序放进数组，再发布新的tail */
+    unsigned tail = *m_sq_tail;
+    unsigned to_submit = m_sqe_tail - m_sqe_head;
+    while(m_sqe_head != m_sqe_tail)
+    {
+        m_sq_array[tail & m_sq_mask] = m_sqe_head & m_sq_mask;
+        tail++;
+        m_sqe_head++;
+    }
+    __atomic_store_n(m_sq_tail, tail, __ATOMIC_RELEASE);
+
+    if(to_submit == 0 && wait_nr == 0)
+        return 0;
+
+    unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    void* parg = NULL;
+    size_t argsz = 0;
+    if(wait_nr > 0 && timeout_ms >= 0)
+    {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+        flags |= IORING_ENTER_EXT_ARG;
+        parg = &arg;
+        argsz = sizeof(arg);
+    }
+
+    int ret = io_uring_enter(m_fd, to_submit, wait_nr, flags, parg, argsz);
+    /* 超时和被信号打断都不算错误，调用者照常检查完成队列 */
+    if(ret < 0 && (errno == ETIME || errno == EINTR))
+        return 0;
+    return ret;
+}
+
+struct io_uring_cqe* IoUring::peek_cqe()
+{
+    unsigned head = *m_cq_head;
+    if(head == __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE))
+        return NULL;
+    return &m_cqes[head & m_cq_mask];
+}
+
+void IoUring::cqe_seen()
+{
+    __atomic_store_n(m_cq_head, *m_cq_head + 1, __ATOMIC_RELEASE);
+}
+
+int IoUring::register_ring(unsigned opcode, void* arg, unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, m_fd, opcode, arg, nr_args);
+}
+
+
+BufferRing::BufferRing()
+    : m_ring(NULL), m_bufs(NULL), m_count(0), m_size(0), m_bgid(0), m_tail(0)
+{
+}
+
+BufferRing::~BufferRing()
+{
+    if(m_ring != NULL)
+        munmap(m_ring, m_count * sizeof(struct io_uring_buf));
+    if(m_bufs != NULL)
+        munmap(m_bufs, (size_t)m_count * m_size);
+}
+
+bool BufferRing::init(IoUring* ring, uint16_t bgid, unsigned count, unsigned size)
+{
+    /* 环本身要按页对齐，匿名映射正好满足 */
+    void* mem = mmap(NULL, count * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mem == MAP_FAILED)
+        return false;
+    m_ring = static_cast<struct io_uring_buf_ring*>(mem);
+    m_count = count;
+
+    mem = mmap(NULL, (size_t)count * size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mem == MAP_FAILED)
+        return false;
+    m_bufs = static_cast<char*>(mem);
+    m_size = size;
+    m_bgid = bgid;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)m_ring;
+    reg.ring_entries = count;
+    reg.bgid = bgid;
+    if(ring->register_ring(IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+        return false;
+
+    for(unsigned i = 0; i < count; i++)
+        recycle((uint16_t)i);
+    return true;
+}
+
+void BufferRing::recycle(uint16_t bid)
+{
+    /* 头文件里的柔性数组在C++下前面多了一个空结构体，bufs的偏移不是0，按环的首地址自己算 */
+    struct io_uring_buf* buf = reinterpret_cast<struct io_uring_buf*>(m_ring) + (m_tail & (m_count - 1));
+    buf->addr = (uint64_t)(uintptr_t)buffer(bid);
+    buf->len = m_size;
+    buf->bid = bid;
+    m_tail++;
+    /* tail和第一个缓冲区的保留字段共用同一个位置 */
+    __atomic_store_n(&m_ring->tail, m_tail, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,103 @@
+#ifndef __IOURING_H
+#define __IOURING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+/*
+ * 直接用io_uring_setup/io_uring_enter/io_uring_register系统调用的提交/完成队列
+ * 只给一个线程使用：get_sqe()填好之后由submit()一次提交，
+ * 完成项用peek_cqe()依次取出，处理完调用cqe_seen()。
+ */
+class IoUring
+{
+    public:
+        IoUring();
+        ~IoUring();
+
+        /* entries个提交项，完成队列是它的cq_factor倍；内核不支持或者被禁用时返回false */
+        bool init(unsigned entries, unsigned cq_factor = 4);
+        int fd() const { return m_fd; }
+
+        /* 取一个已清零的提交项，队列满时先把已有的提交掉 */
+        struct io_uring_sqe* get_sqe();
+        /* 提交队列还能放下的提交项个数，一组链接的操作必须在同一次提交中 */
+        unsigned sq_space() const;
+        /* 提交所有提交项并等待至少wait_nr个完成，timeout_ms为-1时一直等；返回提交的个数 */
+        int submit(unsigned wait_nr = 0, int timeout_ms = -1);
+
+        /* 下一个完成项，没有时返回NULL */
+        struct io_uring_cqe* peek_cqe();
+        void cqe_seen();
+
+        int register_ring(unsigned opcode, void* arg, unsigned nr_args);
+
+        static uint64_t pack(uint32_t op, int fd) { return ((uint64_t)op << 32) | (uint32_t)fd; }
+        static uint32_t op_of(uint64_t user_data) { return (uint32_t)(user_data >> 32); }
+        static int fd_of(uint64_t user_data) { return (int)(uint32_t)user_data; }
+
+    private:
+        IoUring(const IoUring& rhs);
+        IoUring& operator = (const IoUring& rhs);
+
+        void release();
+
+    private:
+        int m_fd;
+
+        /* 提交队列，m_sqe_tail是已经填好的，m_sqe_head是已经放进数组的 */
+        unsigned* m_sq_head;
+        unsigned* m_sq_tail;
+        unsigned m_sq_mask;
+        unsigned* m_sq_array;
+        unsigned m_sq_entries;
+        struct io_uring_sqe* m_sqes;
+        unsigned m_sqe_head;
+        unsigned m_sqe_tail;
+
+        /* 完成队列 */
+        unsigned* m_cq_head;
+        unsigned* m_cq_tail;
+        unsigned m_cq_mask;
+        struct io_uring_cqe* m_cqes;
+
+        void* m_sq_ptr;
+        size_t m_sq_size;
+        void* m_cq_ptr;
+        size_t m_cq_size;
+        size_t m_sqes_size;
+};
+
+
+/*
+ * 注册到io_uring的provided buffer ring
+ * 多发recv每次完成时由内核挑一个缓冲区，用完后recycle()还回去。
+ */
+class BufferRing
+{
+    public:
+        BufferRing();
+        ~BufferRing();
+
+        /* count必须是2的幂 */
+        bool init(IoUring* ring, uint16_t bgid, unsigned count, unsigned size);
+
+        uint16_t bgid() const { return m_bgid; }
+        char* buffer(uint16_t bid) { return m_bufs + (size_t)bid * m_size; }
+        void recycle(uint16_t bid);
+
+    private:
+        BufferRing(const BufferRing& rhs);
+        BufferRing& operator = (const BufferRing& rhs);
+
+    private:
+        struct io_uring_buf_ring* m_ring;
+        char* m_bufs;
+        unsigned m_count;
+        unsigned m_size;
+        uint16_t m_bgid;
+        uint16_t m_tail;
+};
+
+#endif
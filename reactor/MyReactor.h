@@ -0,0 +1,395 @@
+#ifndef __MYREACTOR_H
+#define __MYREACTOR_H
+
+
+#include <iostream>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>  //for htonl() and htons()
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <signal.h>     //for signal()
+#include <pthread.h>
+#include <semaphore.h>
+#include <errno.h>
+#include <list>
+#include <time.h>
+#include <sstream>
+#include <iomanip> //for std::setw()/setfill()
+#include <stdlib.h>
+
+#include <sys/stat.h>
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <sys/resource.h>
+#include "TaskScheduler.h"
+#include "TimerWheel.h"
+#include "Wakeup.h"
+#include "IoUring.h"
+#include "CpuTopology.h"
+#include "Endpoint.h"
+#include "SocketOptions.h"
+#include "ReactorStats.h"
+#include "Connection.h"
+#include "simple_log.h"
+#include "simple_config.h"
+
+/* 一次最多连续accept的连接数，取满后注册完再继续取 */
+#define ACCEPT_BATCH 128
+/* 连接的输出缓冲区积压超过这个字节数就暂停读它，写完后恢复 */
+#define HIGH_WATER_MARK (1024 * 1024)
+/* 共享队列模式下定时器要求唤醒连接，借用epoll从不上报的EPOLLMSG记在revents里 */
+#define CONN_WAKEUP EPOLLMSG
+
+/* 反应堆的运行模式 */
+enum ReactorMode
+{
+    /* 主线程epoll，就绪的fd交给工作线程池 */
+    MODE_WORKER_QUEUE = 0,
+    /* one loop per thread，每个工作线程拥有自己的epoll和连接 */
+    MODE_SUB_REACTOR = 1,
+    /* 在sub reactor基础上，每个子反应堆用SO_REUSEPORT打开自己的监听socket */
+    MODE_REUSEPORT = 2,
+    /* 在reuseport基础上用io_uring代替epoll，accept和收发都是完成事件 */
+    MODE_URING = 3
+};
+
+/* io_uring模式下每个子反应堆的提交队列长度 */
+#define URING_ENTRIES 256
+/* 多发recv使用的缓冲区个数和大小，个数必须是2的幂 */
+#define URING_BUF_COUNT 256
+#define URING_BUF_SIZE (16 * 1024)
+
+/* io_uring完成项的user_data高32位，低32位是fd */
+enum UringOp
+{
+    URING_ACCEPT = 1,
+    URING_RECV = 2,
+    URING_SEND = 3,
+    /* 任务队列的eventfd可读 */
+    URING_TASKS = 4,
+    URING_CANCEL = 5
+};
+
+/* 共享队列模式下连接的归属状态 */
+enum ConnState
+{
+    /* 没有工作线程持有，已在epoll中用EPOLLONESHOT武装 */
+    CONN_IDLE = 0,
+    /* 主线程已经放入分发队列，还没有工作线程取走 */
+    CONN_QUEUED = 3,
+    /* 某个工作线程正在处理 */
+    CONN_OWNED = 1,
+    /* 处理期间又有了新的事件，持有者释放前需要再处理一遍 */
+    CONN_OWNED_DIRTY = 2
+};
+
+struct SubReactor;
+
+/* 以fd为下标的连接状态 */
+struct ConnSlot
+{
+    /* 共享队列模式下的归属状态，见ConnState */
+    std::atomic<int> state;
+    /* 最后一次收到数据的时间，单调时钟毫秒 */
+    std::atomic<int64_t> last_active;
+    /* 共享队列模式下最近一次放进分发队列的时间，单调时钟纳秒 */
+    std::atomic<int64_t> queued_ns;
+    /* 每关闭一次加一，用来识别fd号被复用 */
+    std::atomic<uint32_t> gen;
+    /* 连接的缓冲区和回调，注册时创建，关闭时销毁 */
+    Connection* conn;
+    /* 共享队列模式下主线程收到、工作线程还没处理的事件 */
+    std::atomic<uint32_t> revents;
+    /* 子反应堆模式下拥有这个连接的子反应堆 */
+    std::atomic<SubReactor*> owner;
+
+    /* io_uring模式下内核里还没完成的操作个数，归零之前不能关闭fd，只由拥有者线程访问 */
+    int uring_ops;
+    /* io_uring模式下有多发recv在等待 */
+    bool uring_recv;
+    /* io_uring模式下已经要求关闭，取消了剩下的操作，等uring_ops归零 */
+    bool uring_closing;
+
+    /* 其他线程用deliver()投递给这个连接的消息，由拥有者线程取走放进输出缓冲区 */
+    pthread_mutex_t outbox_mutex = PTHREAD_MUTEX_INITIALIZER;
+    std::vector<std::shared_ptr<const std::string> > outbox;
+    /* 连接注册之后才接收投递，关闭时清空 */
+    bool outbox_open;
+    /* 投递的最后一条消息要求发送完关闭连接，之后的投递丢弃 */
+    bool outbox_close;
+};
+
+/* 子反应堆，一个线程一个 */
+struct SubReactor
+{
+    /* 所属的MyReactor<Handler>，SubReactor不依赖协议，这里不带类型 */
+    void* pReactor;
+    int epollfd;
+    /* MODE_REUSEPORT、MODE_URING下本线程accept的监听socket：自己的SO_REUSEPORT socket和共享的unix socket */
+    std::vector<int> listenfds;
+    /* 每个监听socket对应的地址在m_endpoints中的下标 */
+    std::vector<size_t> listen_endpoints;
+    pthread_t threadid;
+    /* 本线程的定时器 */
+    TimerWheel timers;
+    /* 其他线程投递给本线程执行的任务，fd注册在epollfd中 */
+    TaskQueue tasks;
+    /* MODE_URING下本线程的io_uring和多发recv的缓冲区 */
+    IoUring ring;
+    BufferRing bufs;
+};
+
+/*
+ * 反应堆引擎，协议由Handler在编译期决定，例如MyReactor<EchoHandler>、MyReactor<HttpHandler>。
+ * 引擎直接调用Handler的成员函数，没有虚函数，每个事件的调用路径可以被内联。
+ * Handler需要提供：
+ *   explicit Handler(MyReactor<Handler>* reactor);
+ *   bool init();                                  连接表创建之后、线程启动之前调用，返回false时init失败
+ *   void uninit();                                uninit()中调用，可能在信号处理函数里，只能做异步信号安全的事
+ *   void on_connection(Connection* conn);         新连接注册时在拥有者线程调用
+ *   void on_message(Connection* conn, Buffer* buf);  读到数据，取走处理过的部分
+ *   void on_high_water(Connection* conn, size_t len); 输出积压超过HIGH_WATER_MARK
+ *   void on_close(int clientfd);                  连接关闭前调用，之后fd号可能被复用
+ * 连接上设置了自己的消息回调时（比如协程），读到的数据交给它而不是on_message。
+ */
+template<typename Handler>
+class MyReactor{
+    public:
+        MyReactor();
+        ~MyReactor();
+
+        /* 初始化socket和线程，供应用程序调用 */
+        bool init(const char *ip, short nport, int mode = MODE_WORKER_QUEUE);
+        /* 同时监听多个地址，写法见Endpoint，所有地址上的连接由同一个反应堆处理 */
+        bool init(const std::vector<std::string>& endpoints, int mode = MODE_WORKER_QUEUE);
+        /* 设置listen的backlog，需要在init之前调用 */
+        void set_backlog(int backlog);
+        /* 连接空闲超过seconds秒就关闭，0表示不限制，需要在init之前调用 */
+        void set_idle_timeout(int seconds);
+        /* 工作线程（子反应堆）的个数，0表示按在线CPU数，需要在init之前调用 */
+        void set_thread_num(int num);
+        /* 把各线程绑定到CPU上，numa_aware时子反应堆轮流分到各个NUMA节点，需要在init之前调用 */
+        void set_cpu_affinity(bool on, bool numa_aware);
+        /*
+         * 忙等模式：反应堆先用超时为0的epoll_wait轮询us微秒、工作线程先自旋us微秒再休眠，
+         * 新连接设置SO_BUSY_POLL；用CPU换延迟，0表示关闭，需要在init之前调用
+         */
+        void set_busy_poll(int us);
+        /* -s、-r、-u模式下执行submit()提交的任务的线程数，0表示在提交者线程上直接执行，需要在init之前调用 */
+        void set_offload_threads(int num);
+        /*
+         * 从配置文件读取线程数、CPU绑定和忙等时间，没有的项保持原值，文件打不开时返回false；
+         * 同一目录下的socket.conf是socket选项组，socket_profile指定没有写明选项组的地址用哪一组
+         */
+        bool load_config(const char* config_file);
+        /* static void *accept_thread_proc(void* args); */
+        /* static void *worker_thread_proc(void* args); */
+
+
+        bool uninit();
+
+        /* 各线程计数器的汇总，一行JSON */
+        std::string stats_json();
+        /* 让主线程把统计写进日志，只写eventfd，可以在信号处理函数中调用 */
+        void request_stats_dump();
+
+        bool close_client(int clientfd);
+
+        /*
+         * 把耗时的工作（计算、阻塞的调用）交给工作线程池，任意线程都可以调用。
+         * 在工作线程里提交的任务先放进它自己的队列，空闲的工作线程会偷走；
+         * 任务在别的线程执行，要操作连接时投递回连接的拥有者线程
+         */
+        void submit(const Task& task);
+
+        /*
+         * 任意线程把msg投递给一个连接，由拥有者线程发送；gen是client_gen()的值，
+         * fd已经换成了别的连接时丢弃。close_after为true时msg发送完就关闭连接，比如submit()的任务算出的最后一个回复
+         */
+        void deliver(int clientfd, uint32_t gen, const std::shared_ptr<const std::string>& msg,
+                bool close_after = false);
+        /* delay_ms毫秒后在拥有者线程上调用连接的唤醒回调，连接在这之前关闭时不调用 */
+        void schedule_wakeup(int clientfd, int64_t delay_ms);
+        /* 连接当前的代数，每关闭一次加一 */
+        uint32_t client_gen(int clientfd);
+        /* 连接表的大小，fd都小于它 */
+        int max_clients() const { return (int)m_conns.size(); }
+        /* Handler自己起的线程，绑定CPU时和主线程放在一起，需要在Handler::init()中调用 */
+        void add_thread(pthread_t tid) { m_handler_threadid.push_back(tid); }
+        /* Handler自己的线程启动时调用，计数器和统计里带上它 */
+        void attach_thread(const char* name) { m_stats.attach(name); }
+        bool stopped() const { return m_bStop; }
+        Handler& handler() { return m_handler; }
+
+        static void* main_loop(void* loop);
+
+    private:
+        /* 见条款6，阻止有人调用复制构造函数和赋值运算符构造函数 */
+        MyReactor(const MyReactor& rhs);
+        MyReactor& operator = (const MyReactor& rhs);
+
+        static void *accept_thread_proc(void* args);
+        static void *worker_thread_proc(void* args);
+        static void *sub_reactor_proc(void* args);
+        static void *uring_reactor_proc(void* args);
+
+        /* 共享队列模式下工作线程处理一次分发来的连接 */
+        void serve_client(int clientfd);
+        /* 处理一个客户连接上的可读事件，连接被关闭时返回false */
+        bool handle_client(int epollfd, int clientfd, uint32_t events);
+        /* 读到EAGAIN为止并把数据交给协议，连接被关闭时返回false */
+        bool read_client(Connection* conn);
+        /* 输入缓冲区里有数据时交给连接的消息回调或者Handler::on_message */
+        void deliver_input(Connection* conn);
+        /* 创建连接对象并设置回调 */
+        Connection* new_connection(int epollfd, int clientfd, uint32_t events);
+        void wake_client(int clientfd, uint32_t gen);
+        /* 在拥有者线程把投递来的消息写进连接，连接被关闭时返回false */
+        bool flush_outbox(ConnSlot* slot);
+        bool close_client(int epollfd, int clientfd);
+
+        /* 工作线程取得/释放连接的归属，保证同一时刻只有一个线程处理一个fd */
+        bool claim_client(int clientfd);
+        bool release_client(int clientfd);
+        /* 取出主线程为这个fd累积的事件 */
+        uint32_t take_events(int clientfd);
+        /* 连接当前需要关注的事件，处理完后按它重新武装EPOLLONESHOT */
+        uint32_t client_events(int clientfd);
+        void rearm_client(int clientfd, uint32_t events);
+        /*
+         * 共享队列模式下把就绪、唤醒、投递事件交给工作线程：空闲时放进分发队列，
+         * 已经排队或者正被持有时只记下事件，由持有者再处理一遍。唤醒和投递时fd还在epoll中武装着，
+         * 随后epoll报告它是正常的，也走这里合并
+         */
+        void dispatch_event(ConnSlot* slot, int clientfd, uint32_t events);
+
+        /* 创建epoll和共享的监听socket，reuseport和io_uring模式下TCP地址由子反应堆各自创建 */
+        bool create_server_listener();
+        /* 子反应堆要accept的监听socket，共享的unix socket加入每个子反应堆 */
+        bool create_sub_listeners(SubReactor* pSub);
+        bool is_listener(int fd) const;
+        /* 监听socket对应的地址下标，pSub为NULL时在共享的监听socket中找 */
+        size_t listen_endpoint(SubReactor* pSub, int listenfd) const;
+        /* 关闭子反应堆自己创建的监听socket，共享的由uninit关闭 */
+        void close_sub_listeners(SubReactor* pSub);
+        /* 在本线程的监听socket上接受所有等待的连接 */
+        void accept_clients(int listenfd, SubReactor* pSub);
+        /* 用accept4连续取出最多maxfds个连接，返回取到的个数 */
+        int accept_batch(int listenfd, int* fds, int maxfds);
+        /* 把一批新连接交给各自的反应堆，pSub不为NULL时调用者就是该子反应堆 */
+        void add_clients(SubReactor* pSub, const int* fds, int n, size_t endpoint);
+        /* 在拥有者线程把连接注册到epoll，target为NULL时是主线程 */
+        void register_client(SubReactor* target, int clientfd);
+        /* 把连接注册到拥有者的epoll，失败时关闭它 */
+        bool register_epoll(SubReactor* target, int clientfd);
+        /* 连接对象创建好之后开始接收投递，再交给Handler */
+        void open_client(ConnSlot* slot);
+        /* 按配置把init创建的线程绑定到CPU上 */
+        void pin_threads();
+        /* 把任务队列的eventfd注册到epoll */
+        static bool watch_tasks(int epollfd, TaskQueue* tasks);
+
+        /* 连接的空闲检测，在拥有该连接的反应堆线程上执行 */
+        ConnSlot* conn_slot(int clientfd);
+        void touch_client(int clientfd);
+        void watch_idle(TimerWheel* timers, int epollfd, int clientfd, uint32_t gen, int64_t delay_ms);
+        void check_idle(TimerWheel* timers, int epollfd, int clientfd, uint32_t gen);
+        /* io_uring模式：处理一个完成项，以及提交各种操作 */
+        void handle_completion(SubReactor* pSub, const struct io_uring_cqe* cqe);
+        void uring_accept(SubReactor* pSub, int listenfd);
+        void uring_watch_tasks(SubReactor* pSub);
+        void uring_recv(int clientfd, bool on);
+        void uring_send(int clientfd, const SendSegments& segs);
+        /* 内核里还有这个fd上的操作时取消它们并返回false，等最后一个完成后再关闭 */
+        bool uring_close(int clientfd);
+
+        /* 把就绪的fd交给工作线程池，记下入队时间 */
+        void dispatch(int clientfd);
+        /* 工作线程取到fd时记录排队时间 */
+        void picked_up(int clientfd);
+        /* 在主线程把统计写进日志 */
+        void dump_stats();
+
+        /* 根据最近的定时器计算epoll_wait的超时 */
+        static int poll_timeout(TimerWheel* timers);
+        /* epoll_wait，忙等模式下先非阻塞地轮询，轮询期间有定时器到期时提前返回 */
+        int wait_events(int epollfd, struct epoll_event* events, int maxevents, TimerWheel* timers);
+        /* 记一次唤醒和取到的事件个数，返回n */
+        static int count_wakeup(int n);
+        /* 忙等模式下让内核在recv时直接轮询网卡队列 */
+        void set_busy_poll_socket(int clientfd);
+
+
+    private:
+        /* 监听的地址 */
+        std::vector<Endpoint> m_endpoints;
+        /* 共享的监听socket，共享队列和sub reactor模式下是全部，reuseport和io_uring模式下只有unix socket */
+        std::vector<int> m_listenfds;
+        std::vector<size_t> m_listen_endpoints;
+        /* socket选项组，以及每个地址最终使用的一组，下标同m_endpoints */
+        SocketProfiles m_profiles;
+        std::vector<SocketOptions> m_sockopts;
+        /* 让线程可以修改它 */
+        int m_epollfd = 0;
+        /* 线程ID */
+        pthread_t m_accept_threadid;
+        std::vector<pthread_t> m_threadid;
+        /* Handler自己的线程，见add_thread() */
+        std::vector<pthread_t> m_handler_threadid;
+        /* 工作线程（子反应堆）的个数 */
+        int m_thread_num = CpuTopology::online_cpus();
+        /* 没有工作线程池的模式下，另外为submit()起的线程 */
+        int m_offload_threads = 0;
+        std::vector<pthread_t> m_offload_threadid;
+        /* 是否绑定CPU，绑定时是否按NUMA节点分散子反应堆 */
+        bool m_cpu_affinity = false;
+        bool m_numa_aware = false;
+        /* 忙等的微秒数，0表示不忙等 */
+        int m_busy_poll_us = 0;
+        /* 运行模式 */
+        int m_mode = MODE_WORKER_QUEUE;
+        /* 子反应堆，只在MODE_SUB_REACTOR下使用 */
+        std::vector<SubReactor> m_subreactors;
+        /* 轮询分配新连接的下标 */
+        int m_next_sub = 0;
+        /* 主线程通知accept线程有新连接，计数不会丢失通知 */
+        Wakeup m_accept_wakeup;
+        /* listen的backlog */
+        int m_backlog = SOMAXCONN;
+
+
+        /* 工作线程池：主线程分发的就绪fd和submit()的任务，工作窃取 */
+        TaskScheduler m_scheduler;
+        /* 以fd为下标的连接状态 */
+        std::vector<ConnSlot> m_conns;
+        /* 主线程的定时器 */
+        TimerWheel m_timers;
+        /* 投递给主线程执行的任务 */
+        TaskQueue m_tasks;
+        /* 空闲超时，0表示不检测 */
+        int64_t m_idle_timeout_ms = 0;
+        /* 每个线程的计数器 */
+        ReactorStats m_stats;
+        /* 信号处理函数通过它让主线程输出统计 */
+        Wakeup m_stats_wakeup;
+        /* 发现同一个fd被两个线程同时处理的次数，正常情况下应该一直是0 */
+        std::atomic<long> m_owner_conflicts{0};
+
+
+        /* 决定主线程、accept线程、工作线程是否继续迭代 */
+        bool m_bStop = false;
+
+        /* 协议，最后构造，构造时引擎的其他成员都已经可用 */
+        Handler m_handler;
+};
+
+#include "MyReactorImpl.h"
+
+#endif
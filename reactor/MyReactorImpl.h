@@ -0,0 +1,1532 @@
+/* MyReactor<Handler>的实现，由MyReactor.h在末尾包含，不单独使用 */
+
+
+template<typename Handler>
+MyReactor<Handler>::MyReactor()
+    : m_handler(this)
+{
+}
+
+template<typename Handler>
+MyReactor<Handler>::~MyReactor()
+{
+    /* uninit()之后工作线程可能还在执行最后的任务，等它们退出再析构调度器，最多等一秒 */
+    if(!m_bStop)
+        return;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += 1;
+    std::vector<pthread_t>& workers = m_mode == MODE_WORKER_QUEUE ? m_threadid : m_offload_threadid;
+    for(size_t i = 0; i < workers.size(); i++)
+        pthread_timedjoin_np(workers[i], NULL, &deadline);
+}
+
+template<typename Handler>
+void MyReactor<Handler>::set_backlog(int backlog)
+{
+    if(backlog > 0)
+        m_backlog = backlog;
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::set_idle_timeout(int seconds)
+{
+    m_idle_timeout_ms = seconds > 0 ? (int64_t)seconds * 1000 : 0;
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::set_thread_num(int num)
+{
+    m_thread_num = num > 0 ? num : CpuTopology::online_cpus();
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::set_cpu_affinity(bool on, bool numa_aware)
+{
+    m_cpu_affinity = on;
+    m_numa_aware = numa_aware;
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::set_busy_poll(int us)
+{
+    m_busy_poll_us = us > 0 ? us : 0;
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::set_offload_threads(int num)
+{
+    m_offload_threads = num > 0 ? num : 0;
+}
+
+
+template<typename Handler>
+bool MyReactor<Handler>::load_config(const char* config_file)
+{
+    std::map<std::string, std::string> configs;
+    if(get_config_map(config_file, configs) != 0)
+        return false;
+
+    if(configs.count("worker_threads"))
+        set_thread_num(atoi(configs["worker_threads"].c_str()));
+    if(configs.count("cpu_affinity"))
+        m_cpu_affinity = atoi(configs["cpu_affinity"].c_str()) != 0;
+    if(configs.count("numa_aware"))
+        m_numa_aware = atoi(configs["numa_aware"].c_str()) != 0;
+    if(configs.count("busy_poll_us"))
+        set_busy_poll(atoi(configs["busy_poll_us"].c_str()));
+    if(configs.count("offload_threads"))
+        set_offload_threads(atoi(configs["offload_threads"].c_str()));
+
+    std::string dir = config_file;
+    size_t slash = dir.rfind('/');
+    dir = slash == std::string::npos ? std::string() : dir.substr(0, slash + 1);
+    if(!m_profiles.load(dir + "socket.conf"))
+        LOG_INFO("no %ssocket.conf, sockets use system defaults\n", dir.c_str());
+    if(configs.count("socket_profile"))
+        m_profiles.set_default(configs["socket_profile"]);
+    return true;
+}
+
+
+template<typename Handler>
+bool MyReactor<Handler>::init(const char* ip, short nport, int mode)
+{
+    return init(std::vector<std::string>(1, Endpoint::inet(ip, nport)), mode);
+}
+
+
+template<typename Handler>
+bool MyReactor<Handler>::init(const std::vector<std::string>& endpoints, int mode)
+{
+    m_mode = mode;
+
+    m_endpoints = std::vector<Endpoint>(endpoints.size());
+    for(size_t i = 0; i < endpoints.size(); i++)
+    {
+        if(!m_endpoints[i].parse(endpoints[i]))
+        {
+            LOG_ERROR("bad listen address: %s\n", endpoints[i].c_str());
+            return false;
+        }
+
+        const std::string& name = m_endpoints[i].profile().empty() ? m_profiles.default_name() : m_endpoints[i].profile();
+        const SocketOptions* opts = m_profiles.find(name);
+        if(opts == NULL)
+        {
+            LOG_ERROR("unknown socket profile %s for %s\n", name.c_str(), endpoints[i].c_str());
+            return false;
+        }
+        m_sockopts.push_back(*opts);
+        LOG_INFO("listen %s, socket profile %s: %s\n", endpoints[i].c_str(), name.c_str(), opts->to_string().c_str());
+    }
+
+    if(!create_server_listener())
+        return false;
+
+    /* fd不会超过进程的打开文件数上限 */
+    struct rlimit rl;
+    size_t maxfds = 65536;
+    if(getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY)
+        maxfds = rl.rlim_cur;
+    m_conns = std::vector<ConnSlot>(maxfds);
+
+    if(!m_handler.init())
+        return false;
+
+    if(!watch_tasks(m_epollfd, &m_tasks))
+        return false;
+
+    struct epoll_event e;
+    memset(&e, 0, sizeof(e));
+    e.events = EPOLLIN;
+    e.data.fd = m_stats_wakeup.fd();
+    if(epoll_ctl(m_epollfd, EPOLL_CTL_ADD, m_stats_wakeup.fd(), &e) == -1)
+        return false;
+
+    /* 工作线程没有任务时先自旋，提交者不必每次都用futex唤醒 */
+    m_scheduler.set_spin_us(m_busy_poll_us);
+    m_scheduler.init(m_mode == MODE_WORKER_QUEUE ? m_thread_num : m_offload_threads);
+
+    m_threadid = std::vector<pthread_t>(m_thread_num);
+    m_subreactors = std::vector<SubReactor>(m_thread_num);
+
+    /* reuseport和io_uring模式下各子反应堆自己accept，不需要accept线程 */
+    if(m_mode != MODE_REUSEPORT && m_mode != MODE_URING)
+        pthread_create(&m_accept_threadid, NULL, accept_thread_proc, (void*)this);
+
+    LOG_DEBUG("accept thread \n");
+
+    for(int i = 0; i < m_thread_num; i++)
+    {
+        if(m_mode == MODE_URING)
+        {
+            /* 每个线程一个io_uring和自己的SO_REUSEPORT监听socket，不需要epoll */
+            SubReactor* pSub = &m_subreactors[i];
+            pSub->pReactor = this;
+            pSub->epollfd = -1;
+            if(!create_sub_listeners(pSub))
+                return false;
+            if(!pSub->ring.init(URING_ENTRIES) ||
+               !pSub->bufs.init(&pSub->ring, 0, URING_BUF_COUNT, URING_BUF_SIZE))
+            {
+                LOG_ERROR("io_uring init error: %s\n", strerror(errno));
+                return false;
+            }
+
+            pthread_create(&m_threadid[i], NULL, uring_reactor_proc, (void*)pSub);
+        }
+        else if(m_mode == MODE_SUB_REACTOR || m_mode == MODE_REUSEPORT)
+        {
+            /* 每个子反应堆有自己的epoll，连接的读写都在该线程完成 */
+            m_subreactors[i].pReactor = this;
+            m_subreactors[i].epollfd = epoll_create(1);
+            if(m_subreactors[i].epollfd == -1)
+            {
+                LOG_ERROR("sub reactor epoll_create error\n");
+                return false;
+            }
+            if(!watch_tasks(m_subreactors[i].epollfd, &m_subreactors[i].tasks))
+                return false;
+
+            /* 每个线程绑定同一个端口，由内核把新连接分散到各个监听socket上 */
+            if(m_mode == MODE_REUSEPORT && !create_sub_listeners(&m_subreactors[i]))
+                return false;
+
+            pthread_create(&m_threadid[i], NULL, sub_reactor_proc, (void*)&m_subreactors[i]);
+        }
+        else
+            pthread_create(&m_threadid[i], NULL, worker_thread_proc, (void*)this);
+    }
+
+    /* 子反应堆自己处理连接，工作线程池只执行submit()的任务 */
+    if(m_mode != MODE_WORKER_QUEUE)
+    {
+        m_offload_threadid = std::vector<pthread_t>(m_offload_threads);
+        for(int i = 0; i < m_offload_threads; i++)
+            pthread_create(&m_offload_threadid[i], NULL, worker_thread_proc, (void*)this);
+    }
+
+    LOG_DEBUG("%d worker threads, mode = %d\n", m_thread_num, m_mode);
+
+    /* 忙等的线程比CPU多时，自旋会抢走真正有事可做的线程的CPU，延迟反而更高 */
+    if(m_busy_poll_us > 0 && CpuTopology().cpu_count() <= m_thread_num)
+        LOG_WARN("busy poll with %d threads on %d cpus, spinning threads will compete for cpu\n", m_thread_num, CpuTopology().cpu_count());
+
+    if(m_cpu_affinity)
+        pin_threads();
+
+    return true;
+}
+
+
+template<typename Handler>
+bool MyReactor<Handler>::uninit()
+{
+    m_bStop = true;
+
+    /* 唤醒休眠的工作线程 */
+    m_scheduler.close();
+    m_handler.uninit();
+
+    /* 唤醒accept线程和各个反应堆，uninit()在信号处理函数中调用，这里只能写eventfd */
+    m_accept_wakeup.notify();
+    m_tasks.notify();
+    if(m_mode == MODE_SUB_REACTOR || m_mode == MODE_REUSEPORT || m_mode == MODE_URING)
+    {
+        for(int i = 0; i < m_thread_num; i++)
+            m_subreactors[i].tasks.notify();
+    }
+
+
+    /* 将读端和写端都关闭 */
+    for(size_t i = 0; i < m_listenfds.size(); i++)
+    {
+        shutdown(m_listenfds[i], SHUT_RDWR);
+        close(m_listenfds[i]);
+    }
+    close(m_epollfd);
+
+    /* 不留下socket文件，抽象命名空间的名字随socket一起消失 */
+    for(size_t i = 0; i < m_endpoints.size(); i++)
+        m_endpoints[i].remove_socket_file();
+
+    return true;
+}
+
+
+template<typename Handler>
+void* MyReactor<Handler>::main_loop(void *p)
+{
+    LOG_DEBUG("main thread id = %ld\n", pthread_self());
+
+    MyReactor* pReactor = static_cast<MyReactor*>(p);
+    pReactor->m_stats.attach("main");
+
+    while(!pReactor->m_bStop)
+    {
+        /* std::cout << "main loop" << std::endl; */
+        struct epoll_event ev[1024];
+        /* 空闲时一直睡到下一个定时器到期，其他线程通过m_tasks唤醒 */
+        int n = pReactor->wait_events(pReactor->m_epollfd, ev, 1024, &pReactor->m_timers);
+        if(n < 0)
+        {
+            if(errno != EINTR)
+                LOG_ERROR("epoll_wait error\n");
+            n = 0;
+        }
+
+        for(int i = 0; i < n; i++)
+        {
+            /* 有新连接 */
+            if(pReactor->is_listener(ev[i].data.fd))
+            {
+                pReactor->m_accept_wakeup.notify();
+            }
+            /* accept线程投递过来的新连接等任务 */
+            else if(ev[i].data.fd == pReactor->m_tasks.fd())
+            {
+                pReactor->m_tasks.run_pending();
+            }
+            /* 收到了SIGUSR2 */
+            else if(ev[i].data.fd == pReactor->m_stats_wakeup.fd())
+            {
+                pReactor->m_stats_wakeup.drain();
+                pReactor->dump_stats();
+            }
+            /* 有数据 */
+            else
+            {
+                /* 标记为已入队，空闲检测不会关闭还没被取走的fd */
+                ConnSlot* slot = pReactor->conn_slot(ev[i].data.fd);
+                if(slot != NULL)
+                    pReactor->dispatch_event(slot, ev[i].data.fd, ev[i].events);
+                else
+                    pReactor->dispatch(ev[i].data.fd);
+            }
+        }
+
+        pReactor->m_timers.tick();
+    }
+
+    LOG_DEBUG("main loop exit ...\n");
+    return NULL;
+}
+
+
+template<typename Handler>
+bool MyReactor<Handler>::close_client(int clientfd)
+{
+    return close_client(m_epollfd, clientfd);
+}
+
+
+template<typename Handler>
+bool MyReactor<Handler>::close_client(int epollfd, int clientfd)
+{
+    /* io_uring模式下内核里可能还有这个fd上的recv和send，要等它们都完成才能关闭 */
+    if(m_mode == MODE_URING)
+    {
+        if(!uring_close(clientfd))
+            return true;
+    }
+    else if(epoll_ctl(epollfd, EPOLL_CTL_DEL, clientfd, NULL) == -1)
+    {
+        LOG_DEBUG("release client socket failed as call epoll_ctl fail\n");
+    }
+
+    /* 先让协议忘掉这个连接再增加gen，其他线程手里的旧gen都会失效 */
+    m_handler.on_close(clientfd);
+
+    /* 在close之前复位，fd号被新连接复用时从CONN_IDLE开始，旧的定时器也随之失效 */
+    ConnSlot* slot = conn_slot(clientfd);
+    if(slot != NULL)
+    {
+        slot->gen++;
+        delete slot->conn;
+        slot->conn = NULL;
+        slot->revents.store(0);
+        slot->uring_recv = false;
+        slot->uring_closing = false;
+        slot->state.store(CONN_IDLE);
+
+        pthread_mutex_lock(&slot->outbox_mutex);
+        slot->outbox.clear();
+        slot->outbox_open = false;
+        slot->outbox_close = false;
+        pthread_mutex_unlock(&slot->outbox_mutex);
+    }
+
+    close(clientfd);
+    return true;
+}
+
+
+template<typename Handler>
+bool MyReactor<Handler>::create_server_listener()
+{
+    m_epollfd = epoll_create(1);
+    if(m_epollfd == -1)
+        return false;
+
+    bool own_listeners = m_mode == MODE_REUSEPORT || m_mode == MODE_URING;
+    for(size_t i = 0; i < m_endpoints.size(); i++)
+    {
+        /* reuseport和io_uring模式下TCP地址由每个子反应堆自己监听 */
+        const Endpoint& ep = m_endpoints[i];
+        if(own_listeners && ep.reuseport())
+            continue;
+
+        int listenfd = ep.listen_socket(m_backlog, false);
+        if(listenfd == -1)
+        {
+            LOG_ERROR("Unable to bind: %s, %s\n", ep.spec().c_str(), strerror(errno));
+            return false;
+        }
+        m_sockopts[i].apply_listener(listenfd, ep.family());
+        m_listenfds.push_back(listenfd);
+        m_listen_endpoints.push_back(i);
+        if(own_listeners)
+            continue;
+
+        /* 每次就绪只通知一次，accept线程把等待队列取空后再重新武装 */
+        struct epoll_event e;
+        memset(&e, 0, sizeof(e));
+        e.events = EPOLLIN | EPOLLONESHOT;
+        e.data.fd = listenfd;
+        if(epoll_ctl(m_epollfd, EPOLL_CTL_ADD, listenfd, &e) == -1)
+            return false;
+    }
+
+    return true;
+}
+
+
+template<typename Handler>
+bool MyReactor<Handler>::create_sub_listeners(SubReactor* pSub)
+{
+    for(size_t i = 0; i < m_endpoints.size(); i++)
+    {
+        if(!m_endpoints[i].reuseport())
+            continue;
+        int listenfd = m_endpoints[i].listen_socket(m_backlog, true);
+        if(listenfd == -1)
+        {
+            LOG_ERROR("Unable to bind reuseport listener: %s, %s\n", m_endpoints[i].spec().c_str(), strerror(errno));
+            return false;
+        }
+        m_sockopts[i].apply_listener(listenfd, m_endpoints[i].family());
+        pSub->listenfds.push_back(listenfd);
+        pSub->listen_endpoints.push_back(i);
+    }
+    /* unix socket不能重复绑定，所有子反应堆从同一个监听socket上accept */
+    pSub->listenfds.insert(pSub->listenfds.end(), m_listenfds.begin(), m_listenfds.end());
+    pSub->listen_endpoints.insert(pSub->listen_endpoints.end(), m_listen_endpoints.begin(), m_listen_endpoints.end());
+
+    if(m_mode == MODE_URING)
+        return true;
+
+    for(size_t i = 0; i < pSub->listenfds.size(); i++)
+    {
+        int listenfd = pSub->listenfds[i];
+        struct epoll_event e;
+        memset(&e, 0, sizeof(e));
+        e.events = EPOLLIN;
+        /* 共享的监听socket来了新连接时只唤醒其中一个子反应堆 */
+        if(is_listener(listenfd))
+            e.events |= EPOLLEXCLUSIVE;
+        e.data.fd = listenfd;
+        if(epoll_ctl(pSub->epollfd, EPOLL_CTL_ADD, listenfd, &e) == -1)
+            return false;
+    }
+    return true;
+}
+
+
+template<typename Handler>
+bool MyReactor<Handler>::is_listener(int fd) const
+{
+    for(size_t i = 0; i < m_listenfds.size(); i++)
+    {
+        if(m_listenfds[i] == fd)
+            return true;
+    }
+    return false;
+}
+
+
+template<typename Handler>
+size_t MyReactor<Handler>::listen_endpoint(SubReactor* pSub, int listenfd) const
+{
+    const std::vector<int>& fds = pSub != NULL ? pSub->listenfds : m_listenfds;
+    const std::vector<size_t>& endpoints = pSub != NULL ? pSub->listen_endpoints : m_listen_endpoints;
+    size_t i = std::find(fds.begin(), fds.end(), listenfd) - fds.begin();
+    return i < endpoints.size() ? endpoints[i] : 0;
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::close_sub_listeners(SubReactor* pSub)
+{
+    for(size_t i = 0; i < pSub->listenfds.size(); i++)
+    {
+        if(!is_listener(pSub->listenfds[i]))
+            close(pSub->listenfds[i]);
+    }
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::accept_clients(int listenfd, SubReactor* pSub)
+{
+    int fds[ACCEPT_BATCH];
+    int n;
+    size_t endpoint = listen_endpoint(pSub, listenfd);
+    do
+    {
+        n = accept_batch(listenfd, fds, ACCEPT_BATCH);
+        add_clients(pSub, fds, n, endpoint);
+    } while(n == ACCEPT_BATCH);
+}
+
+
+template<typename Handler>
+int MyReactor<Handler>::accept_batch(int listenfd, int* fds, int maxfds)
+{
+    int n = 0;
+    while(n < maxfds)
+    {
+        /* 一次系统调用同时设置non-blocking和close-on-exec */
+        int newfd = accept4(listenfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(newfd == -1)
+        {
+            /* 连接在accept之前被对端重置了，继续取下一个 */
+            if(errno == EINTR || errno == ECONNABORTED)
+                continue;
+            /* 等待队列已经取空 */
+            if(errno != EAGAIN && errno != EWOULDBLOCK)
+                LOG_ERROR("accept error, listenfd = %d\n", listenfd);
+            break;
+        }
+        fds[n++] = newfd;
+    }
+    return n;
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::add_clients(SubReactor* pSub, const int* fds, int n, size_t endpoint)
+{
+    if(n <= 0)
+        return;
+    ReactorStats::add(&ThreadStats::accepts, n);
+
+    for(int i = 0; i < n; i++)
+    {
+        /* sub reactor模式下轮询交给一个子反应堆，之后该连接的读写都由它负责 */
+        SubReactor* target = pSub;
+        if(target == NULL && m_mode == MODE_SUB_REACTOR)
+        {
+            target = &m_subreactors[m_next_sub];
+            m_next_sub = (m_next_sub + 1) % m_thread_num;
+        }
+
+        /* 注册和空闲定时器都在拥有者线程完成，其他线程投递过去 */
+        int clientfd = fds[i];
+        set_busy_poll_socket(clientfd);
+        m_sockopts[endpoint].apply_connection(clientfd, m_endpoints[endpoint].family());
+        if(pSub != NULL)
+            register_client(target, clientfd);
+        else
+        {
+            TaskQueue* tasks = target != NULL ? &target->tasks : &m_tasks;
+            tasks->post([this, target, clientfd]() {
+                register_client(target, clientfd);
+            });
+        }
+    }
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::register_client(SubReactor* target, int clientfd)
+{
+    int targetfd = target != NULL ? target->epollfd : m_epollfd;
+    ConnSlot* slot = conn_slot(clientfd);
+
+    /* io_uring模式下没有epoll，创建连接后直接提交多发recv */
+    if(m_mode == MODE_URING)
+    {
+        if(slot == NULL)
+        {
+            close(clientfd);
+            return;
+        }
+        slot->conn = new_connection(-1, clientfd, EPOLLIN);
+        slot->conn->set_completion_io(
+            [this](Connection* c, const SendSegments& segs) { uring_send(c->fd(), segs); },
+            [this](Connection* c, bool on) { uring_recv(c->fd(), on); });
+        slot->owner.store(target);
+        open_client(slot);
+        uring_recv(clientfd, true);
+    }
+    else if(!register_epoll(target, clientfd))
+        return;
+
+    /* 空闲检测的定时器放在拥有这个连接的反应堆上 */
+    if(m_idle_timeout_ms > 0 && slot != NULL)
+    {
+        TimerWheel* timers = target != NULL ? &target->timers : &m_timers;
+        slot->last_active.store(TimerWheel::now_ms());
+        watch_idle(timers, targetfd, clientfd, slot->gen.load(), m_idle_timeout_ms);
+    }
+}
+
+
+template<typename Handler>
+bool MyReactor<Handler>::register_epoll(SubReactor* target, int clientfd)
+{
+    int targetfd = target != NULL ? target->epollfd : m_epollfd;
+
+    struct epoll_event e;
+    memset(&e, 0, sizeof(e));
+    e.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    /* 共享队列模式下每次就绪只分发一次，由处理完的工作线程重新武装 */
+    if(m_mode == MODE_WORKER_QUEUE)
+        e.events |= EPOLLONESHOT;
+    e.data.fd = clientfd;
+
+    /* 先创建连接对象，注册之后工作线程随时可能处理这个fd */
+    ConnSlot* slot = conn_slot(clientfd);
+    if(slot != NULL)
+    {
+        slot->conn = new_connection(targetfd, clientfd, e.events);
+        slot->owner.store(target);
+        open_client(slot);
+    }
+
+    /* 添加进epoll的兴趣列表 */
+    if(epoll_ctl(targetfd, EPOLL_CTL_ADD, clientfd, &e) == -1)
+    {
+        LOG_ERROR("epoll_ctl error, fd = %d\n", clientfd);
+        close_client(targetfd, clientfd);
+        return false;
+    }
+
+    return true;
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::pin_threads()
+{
+    CpuTopology topo;
+    /*
+     * 子反应堆之间不共享连接，NUMA感知时轮流放到各个节点上；
+     * 共享队列模式的工作线程争用同一个队列，紧凑地排在同一个节点内
+     */
+    std::vector<int> cpus = topo.placement(m_numa_aware && m_mode != MODE_WORKER_QUEUE);
+    if(cpus.empty())
+        return;
+
+    /* 主线程（init之后运行main_loop）和accept线程放在第一个CPU上，和0号工作线程同一个节点 */
+    std::vector<pthread_t> threads;
+    threads.push_back(pthread_self());
+    if(m_mode != MODE_REUSEPORT && m_mode != MODE_URING)
+        threads.push_back(m_accept_threadid);
+    threads.insert(threads.end(), m_handler_threadid.begin(), m_handler_threadid.end());
+    for(size_t i = 0; i < threads.size(); i++)
+    {
+        int cpu = cpus[0];
+        if(!CpuTopology::pin(threads[i], cpu))
+            LOG_ERROR("pin thread to cpu %d failed\n", cpu);
+    }
+
+    /* 线程数多于CPU时依次轮回 */
+    for(int i = 0; i < m_thread_num; i++)
+    {
+        int cpu = cpus[i % cpus.size()];
+        if(!CpuTopology::pin(m_threadid[i], cpu))
+            LOG_ERROR("pin thread to cpu %d failed\n", cpu);
+    }
+
+    LOG_DEBUG("%d threads pinned, %d numa nodes\n", (int)threads.size() + m_thread_num, topo.node_count());
+}
+
+
+template<typename Handler>
+bool MyReactor<Handler>::watch_tasks(int epollfd, TaskQueue* tasks)
+{
+    struct epoll_event e;
+    memset(&e, 0, sizeof(e));
+    e.events = EPOLLIN;
+    e.data.fd = tasks->fd();
+    if(epoll_ctl(epollfd, EPOLL_CTL_ADD, tasks->fd(), &e) == -1)
+    {
+        LOG_ERROR("register task queue error, fd = %d\n", tasks->fd());
+        return false;
+    }
+    return true;
+}
+
+
+template<typename Handler>
+ConnSlot* MyReactor<Handler>::conn_slot(int clientfd)
+{
+    if(clientfd < 0 || clientfd >= (int)m_conns.size())
+        return NULL;
+    return &m_conns[clientfd];
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::touch_client(int clientfd)
+{
+    ConnSlot* slot = conn_slot(clientfd);
+    if(m_idle_timeout_ms > 0 && slot != NULL)
+        slot->last_active.store(TimerWheel::now_ms(), std::memory_order_relaxed);
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::watch_idle(TimerWheel* timers, int epollfd, int clientfd, uint32_t gen, int64_t delay_ms)
+{
+    timers->add_timer(delay_ms, [=, this]() {
+        check_idle(timers, epollfd, clientfd, gen);
+    });
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::check_idle(TimerWheel* timers, int epollfd, int clientfd, uint32_t gen)
+{
+    ConnSlot* slot = conn_slot(clientfd);
+    /* 连接已经关闭，fd号可能已经属于新连接 */
+    if(slot == NULL || slot->gen.load() != gen)
+        return;
+
+    /* 期间有过数据，按最后活跃时间重新计时 */
+    int64_t idle = TimerWheel::now_ms() - slot->last_active.load(std::memory_order_relaxed);
+    if(idle < m_idle_timeout_ms)
+    {
+        watch_idle(timers, epollfd, clientfd, gen, m_idle_timeout_ms - idle);
+        return;
+    }
+
+    /* 共享队列模式下要先取得归属，正在被处理的连接说明还活跃 */
+    if(m_mode == MODE_WORKER_QUEUE)
+    {
+        int expected = CONN_IDLE;
+        if(!slot->state.compare_exchange_strong(expected, CONN_OWNED))
+        {
+            watch_idle(timers, epollfd, clientfd, gen, m_idle_timeout_ms);
+            return;
+        }
+    }
+
+    LOG_INFO("idle timeout, close client fd = %d\n", clientfd);
+    close_client(epollfd, clientfd);
+}
+
+
+template<typename Handler>
+int MyReactor<Handler>::poll_timeout(TimerWheel* timers)
+{
+    /* 没有定时器时一直等待，退出由uninit()通过eventfd唤醒 */
+    return timers->next_timeout();
+}
+
+
+template<typename Handler>
+int MyReactor<Handler>::wait_events(int epollfd, struct epoll_event* events, int maxevents, TimerWheel* timers)
+{
+    if(m_busy_poll_us > 0)
+    {
+        /* 事件通常在几微秒内到达，轮询可以省掉一次休眠和唤醒 */
+        struct timespec start, now;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        while(!m_bStop)
+        {
+            int n = epoll_wait(epollfd, events, maxevents, 0);
+            if(n != 0 || timers->next_timeout() == 0)
+                return count_wakeup(n);
+
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            int64_t elapsed_us = (int64_t)(now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000;
+            if(elapsed_us >= m_busy_poll_us)
+                break;
+        }
+    }
+
+    return count_wakeup(epoll_wait(epollfd, events, maxevents, poll_timeout(timers)));
+}
+
+
+template<typename Handler>
+int MyReactor<Handler>::count_wakeup(int n)
+{
+    ReactorStats::add(&ThreadStats::wakeups, 1);
+    if(n > 0)
+        ReactorStats::add(&ThreadStats::events, n);
+    return n;
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::dispatch(int clientfd)
+{
+    ConnSlot* slot = conn_slot(clientfd);
+    if(slot != NULL)
+        slot->queued_ns.store(ReactorStats::now_ns(), std::memory_order_relaxed);
+    m_scheduler.submit([this, clientfd]() {
+        serve_client(clientfd);
+    });
+    ReactorStats::add(&ThreadStats::dispatched, 1);
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::submit(const Task& task)
+{
+    /* 没有工作线程池时就地执行 */
+    if(m_mode != MODE_WORKER_QUEUE && m_offload_threads == 0)
+        task();
+    else
+        m_scheduler.submit(task);
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::picked_up(int clientfd)
+{
+    ConnSlot* slot = conn_slot(clientfd);
+    if(slot != NULL)
+        ReactorStats::add_pickup(ReactorStats::now_ns() - slot->queued_ns.load(std::memory_order_relaxed));
+}
+
+
+template<typename Handler>
+std::string MyReactor<Handler>::stats_json()
+{
+    return m_stats.to_json(m_scheduler.size(), m_owner_conflicts.load());
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::request_stats_dump()
+{
+    m_stats_wakeup.notify();
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::dump_stats()
+{
+    /* 日志一行有长度限制，线程多时分开写 */
+    LOG_INFO("stats: %s\n", m_stats.to_json(m_scheduler.size(), m_owner_conflicts.load(), false).c_str());
+    std::vector<std::string> threads = m_stats.thread_json();
+    for(size_t i = 0; i < threads.size(); i++)
+        LOG_INFO("stats thread: %s\n", threads[i].c_str());
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::set_busy_poll_socket(int clientfd)
+{
+    if(m_busy_poll_us <= 0)
+        return;
+
+    /* 超过net.core.busy_read需要CAP_NET_ADMIN，失败时只是没有网卡层的轮询，不影响使用 */
+#ifdef SO_BUSY_POLL
+    int us = m_busy_poll_us;
+    setsockopt(clientfd, SOL_SOCKET, SO_BUSY_POLL, &us, sizeof(us));
+#endif
+#ifdef SO_PREFER_BUSY_POLL
+    int on = 1;
+    setsockopt(clientfd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &on, sizeof(on));
+#endif
+}
+
+
+template<typename Handler>
+void* MyReactor<Handler>::accept_thread_proc(void* args)
+{
+    MyReactor* pReactor = static_cast<MyReactor*>(args);
+    pReactor->m_stats.attach("accept");
+
+    while(!pReactor->m_bStop)
+    {
+        /* 等待主线程通知，先到的通知会累加在eventfd里 */
+        pReactor->m_accept_wakeup.wait();
+
+        if(pReactor->m_bStop)
+            break;
+
+        /*
+         * 一次唤醒把每个监听socket的等待队列都取空，按批注册；
+         * 没有就绪的socket只多一次返回EAGAIN的accept4
+         */
+        for(size_t i = 0; i < pReactor->m_listenfds.size(); i++)
+        {
+            int listenfd = pReactor->m_listenfds[i];
+            pReactor->accept_clients(listenfd, NULL);
+
+            /* 重新武装监听socket */
+            struct epoll_event e;
+            memset(&e, 0, sizeof(e));
+            e.events = EPOLLIN | EPOLLONESHOT;
+            e.data.fd = listenfd;
+            if(epoll_ctl(pReactor->m_epollfd, EPOLL_CTL_MOD, listenfd, &e) == -1)
+            {
+                LOG_ERROR("rearm listener failed, listenfd = %d\n", listenfd);
+            }
+        }
+
+        LOG_DEBUG("new client connected: ");
+    }
+
+    return NULL;
+}
+
+template<typename Handler>
+void* MyReactor<Handler>::worker_thread_proc(void* args)
+{
+    MyReactor* pReactor = static_cast<MyReactor*>(args);
+    pReactor->m_stats.attach("worker");
+
+    /* 执行分发来的连接和submit()的任务，uninit()关闭调度器后退出 */
+    pReactor->m_scheduler.run();
+    return NULL;
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::serve_client(int clientfd)
+{
+    picked_up(clientfd);
+
+    /* 已经有线程持有这个连接，由它再处理一遍 */
+    if(!claim_client(clientfd))
+        return;
+
+    /* 先释放归属再重新武装，武装之前不会有其他线程拿到这个fd */
+    /* 释放之后连接可能被空闲检测关闭，要在释放之前取得需要武装的事件 */
+    bool bOpen = true;
+    uint32_t events = 0;
+    do
+    {
+        bOpen = handle_client(m_epollfd, clientfd, take_events(clientfd));
+        if(bOpen)
+            events = client_events(clientfd);
+    } while(bOpen && !release_client(clientfd));
+
+    if(bOpen)
+        rearm_client(clientfd, events);
+}
+
+
+template<typename Handler>
+bool MyReactor<Handler>::claim_client(int clientfd)
+{
+    ConnSlot* slot = conn_slot(clientfd);
+    if(slot == NULL)
+        return true;
+
+    std::atomic<int>& state = slot->state;
+    int expected = CONN_QUEUED;
+    while(!state.compare_exchange_weak(expected, CONN_OWNED))
+    {
+        if(expected == CONN_IDLE || expected == CONN_QUEUED)
+            continue;
+        /* dispatch_event只在空闲时入队，一个fd不会有两个任务，走到这里说明归属出了错 */
+        if(state.compare_exchange_weak(expected, CONN_OWNED_DIRTY))
+        {
+            m_owner_conflicts++;
+            LOG_ERROR("fd = %d dispatched while owned by another worker\n", clientfd);
+            return false;
+        }
+    }
+    return true;
+}
+
+
+template<typename Handler>
+bool MyReactor<Handler>::release_client(int clientfd)
+{
+    ConnSlot* slot = conn_slot(clientfd);
+    if(slot == NULL)
+        return true;
+
+    /* 持有期间被标记过，回到CONN_OWNED由调用者再处理一遍 */
+    int expected = CONN_OWNED;
+    if(slot->state.compare_exchange_strong(expected, CONN_IDLE))
+        return true;
+    slot->state.store(CONN_OWNED);
+    return false;
+}
+
+
+template<typename Handler>
+uint32_t MyReactor<Handler>::take_events(int clientfd)
+{
+    ConnSlot* slot = conn_slot(clientfd);
+    uint32_t events = slot != NULL ? slot->revents.exchange(0) : 0;
+    /* 没有记录到事件时按可读处理，多读一次只会得到EAGAIN */
+    return events != 0 ? events : EPOLLIN;
+}
+
+
+template<typename Handler>
+uint32_t MyReactor<Handler>::client_events(int clientfd)
+{
+    ConnSlot* slot = conn_slot(clientfd);
+    if(slot == NULL || slot->conn == NULL)
+        return EPOLLIN | EPOLLRDHUP | EPOLLET | EPOLLONESHOT;
+    return slot->conn->events();
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::rearm_client(int clientfd, uint32_t events)
+{
+    struct epoll_event e;
+    memset(&e, 0, sizeof(e));
+    e.events = events;
+    e.data.fd = clientfd;
+    if(epoll_ctl(m_epollfd, EPOLL_CTL_MOD, clientfd, &e) == -1)
+    {
+        LOG_ERROR("rearm client failed, fd = %d\n", clientfd);
+    }
+}
+
+
+template<typename Handler>
+void* MyReactor<Handler>::sub_reactor_proc(void* args)
+{
+    SubReactor* pSub = static_cast<SubReactor*>(args);
+    MyReactor* pReactor = static_cast<MyReactor*>(pSub->pReactor);
+    pReactor->m_stats.attach("sub_reactor");
+
+    LOG_DEBUG("sub reactor thread id = %ld, epollfd = %d\n", pthread_self(), pSub->epollfd);
+
+    while(!pReactor->m_bStop)
+    {
+        struct epoll_event ev[1024];
+        int n = pReactor->wait_events(pSub->epollfd, ev, 1024, &pSub->timers);
+        if(n < 0)
+        {
+            if(errno != EINTR)
+                LOG_ERROR("sub reactor epoll_wait error\n");
+            n = 0;
+        }
+
+        /* 连接只属于本线程，直接处理，不经过共享链表 */
+        for(int i = 0; i < n; i++)
+        {
+            if(std::find(pSub->listenfds.begin(), pSub->listenfds.end(), ev[i].data.fd) != pSub->listenfds.end())
+                pReactor->accept_clients(ev[i].data.fd, pSub);
+            else if(ev[i].data.fd == pSub->tasks.fd())
+                pSub->tasks.run_pending();
+            else
+                pReactor->handle_client(pSub->epollfd, ev[i].data.fd, ev[i].events);
+        }
+
+        pSub->timers.tick();
+    }
+
+    pReactor->close_sub_listeners(pSub);
+    close(pSub->epollfd);
+    LOG_DEBUG("sub reactor exit ...\n");
+    return NULL;
+}
+
+
+template<typename Handler>
+void* MyReactor<Handler>::uring_reactor_proc(void* args)
+{
+    SubReactor* pSub = static_cast<SubReactor*>(args);
+    MyReactor* pReactor = static_cast<MyReactor*>(pSub->pReactor);
+    pReactor->m_stats.attach("uring");
+
+    LOG_DEBUG("uring reactor thread id = %ld, ringfd = %d\n", pthread_self(), pSub->ring.fd());
+
+    for(size_t i = 0; i < pSub->listenfds.size(); i++)
+        pReactor->uring_accept(pSub, pSub->listenfds[i]);
+    pReactor->uring_watch_tasks(pSub);
+
+    while(!pReactor->m_bStop)
+    {
+        /* 提交上一轮产生的操作并等待完成，一次系统调用代替epoll_wait和各自的accept/recv/send */
+        if(pSub->ring.submit(1, poll_timeout(&pSub->timers)) < 0 && errno != EBUSY)
+            LOG_ERROR("io_uring_enter error: %s\n", strerror(errno));
+
+        /* 先复制并归还完成项，处理时提交新操作不会覆盖它 */
+        struct io_uring_cqe* cqe;
+        uint64_t n = 0;
+        while((cqe = pSub->ring.peek_cqe()) != NULL)
+        {
+            struct io_uring_cqe c = *cqe;
+            pSub->ring.cqe_seen();
+            pReactor->handle_completion(pSub, &c);
+            n++;
+        }
+        ReactorStats::add(&ThreadStats::wakeups, 1);
+        ReactorStats::add(&ThreadStats::events, n);
+
+        pSub->timers.tick();
+    }
+
+    pReactor->close_sub_listeners(pSub);
+    LOG_DEBUG("uring reactor exit ...\n");
+    return NULL;
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::handle_completion(SubReactor* pSub, const struct io_uring_cqe* cqe)
+{
+    uint32_t op = IoUring::op_of(cqe->user_data);
+    int fd = IoUring::fd_of(cqe->user_data);
+    /* 多发操作还会继续产生完成项，没有这个标志时要重新提交 */
+    bool more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+
+    if(op == URING_ACCEPT)
+    {
+        if(cqe->res >= 0)
+        {
+            int clientfd = cqe->res;
+            add_clients(pSub, &clientfd, 1, listen_endpoint(pSub, fd));
+        }
+        else if(cqe->res != -ECANCELED)
+            LOG_ERROR("accept error: %s\n", strerror(-cqe->res));
+        if(!more && !m_bStop)
+            uring_accept(pSub, fd);
+        return;
+    }
+    if(op == URING_TASKS)
+    {
+        pSub->tasks.run_pending();
+        if(!more && !m_bStop)
+            uring_watch_tasks(pSub);
+        return;
+    }
+    if(op == URING_CANCEL)
+        return;
+
+    ConnSlot* slot = conn_slot(fd);
+    if(slot == NULL)
+        return;
+    /* 已经要求关闭的连接只等操作结束，不再调用回调 */
+    bool alive = !slot->uring_closing && slot->conn != NULL;
+
+    if(op == URING_RECV)
+    {
+        /* 内核挑的缓冲区拷进连接的输入缓冲区后马上还回去 */
+        if(cqe->flags & IORING_CQE_F_BUFFER)
+        {
+            uint16_t bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+            if(alive && cqe->res > 0)
+            {
+                touch_client(fd);
+                Connection* conn = slot->conn;
+                conn->append_input(pSub->bufs.buffer(bid), cqe->res);
+                deliver_input(conn);
+                alive = conn->finish_event() && !slot->uring_closing;
+            }
+            pSub->bufs.recycle(bid);
+        }
+        if(more)
+            return;
+
+        slot->uring_recv = false;
+        slot->uring_ops--;
+        if(alive)
+        {
+            /* 缓冲区被用完或者暂停读取时被取消，还需要读就重新提交 */
+            if(cqe->res > 0 || cqe->res == -ENOBUFS || cqe->res == -ECANCELED)
+            {
+                if(slot->conn->reading())
+                    uring_recv(fd, true);
+            }
+            else if(cqe->res == 0)
+                slot->conn->handle_eof();
+            else
+                slot->conn->close();
+        }
+    }
+    else if(op == URING_SEND)
+    {
+        slot->uring_ops--;
+        if(alive)
+            slot->conn->handle_sent(cqe->res);
+    }
+
+    if(slot->uring_closing && slot->uring_ops == 0)
+        close_client(pSub->epollfd, fd);
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::uring_accept(SubReactor* pSub, int listenfd)
+{
+    struct io_uring_sqe* sqe = pSub->ring.get_sqe();
+    if(sqe == NULL)
+        return;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenfd;
+    /* 一次提交持续接受新连接，每个连接一个完成项 */
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = IoUring::pack(URING_ACCEPT, listenfd);
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::uring_watch_tasks(SubReactor* pSub)
+{
+    struct io_uring_sqe* sqe = pSub->ring.get_sqe();
+    if(sqe == NULL)
+        return;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = pSub->tasks.fd();
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = IoUring::pack(URING_TASKS, pSub->tasks.fd());
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::uring_recv(int clientfd, bool on)
+{
+    ConnSlot* slot = conn_slot(clientfd);
+    SubReactor* pSub = slot->owner.load();
+    /* 已经在读，或者取消还没有完成时不重复提交 */
+    if(on == slot->uring_recv)
+        return;
+
+    struct io_uring_sqe* sqe = pSub->ring.get_sqe();
+    if(sqe == NULL)
+    {
+        LOG_ERROR("io_uring submission queue full, fd = %d\n", clientfd);
+        return;
+    }
+
+    if(on)
+    {
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = clientfd;
+        /* 数据到了就完成一次，由内核从缓冲区组里挑缓冲区 */
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = pSub->bufs.bgid();
+        sqe->user_data = IoUring::pack(URING_RECV, clientfd);
+        slot->uring_recv = true;
+        slot->uring_ops++;
+    }
+    else
+    {
+        /* 暂停读取，recv以-ECANCELED结束后不再提交 */
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = IoUring::pack(URING_RECV, clientfd);
+        sqe->user_data = IoUring::pack(URING_CANCEL, clientfd);
+    }
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::uring_send(int clientfd, const SendSegments& segs)
+{
+    ConnSlot* slot = conn_slot(clientfd);
+    IoUring* ring = &slot->owner.load()->ring;
+
+    /* 一组链接的发送必须在同一次提交里，放不下时先把已有的提交掉 */
+    if(ring->sq_space() < segs.size())
+        ring->submit();
+
+    for(size_t i = 0; i < segs.size(); i++)
+    {
+        struct io_uring_sqe* sqe = ring->get_sqe();
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = clientfd;
+        sqe->addr = (uint64_t)(uintptr_t)segs[i]->data();
+        sqe->len = segs[i]->size();
+        /* 短写时内核自己接着写，而不是让后面链接的段被取消 */
+        sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+        /* 按顺序一段写完再写下一段 */
+        if(i + 1 < segs.size())
+            sqe->flags = IOSQE_IO_LINK;
+        sqe->user_data = IoUring::pack(URING_SEND, clientfd);
+        slot->uring_ops++;
+    }
+}
+
+
+template<typename Handler>
+bool MyReactor<Handler>::uring_close(int clientfd)
+{
+    ConnSlot* slot = conn_slot(clientfd);
+    if(slot == NULL || slot->uring_ops == 0)
+        return true;
+    if(slot->uring_closing)
+        return false;
+
+    /* 不再接受新的发送，取消这个fd上所有还在等待的操作，最后一个完成时由handle_completion关闭 */
+    slot->uring_closing = true;
+    if(slot->conn != NULL)
+        slot->conn->close_later();
+
+    struct io_uring_sqe* sqe = slot->owner.load()->ring.get_sqe();
+    if(sqe != NULL)
+    {
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = clientfd;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+        sqe->user_data = IoUring::pack(URING_CANCEL, clientfd);
+    }
+    return false;
+}
+
+
+template<typename Handler>
+bool MyReactor<Handler>::handle_client(int epollfd, int clientfd, uint32_t events)
+{
+    if(events & EPOLLIN)
+        touch_client(clientfd);
+
+    /* 连接已经关闭，是过时的事件；fd号可能已经不属于这个反应堆，不能再close */
+    ConnSlot* slot = conn_slot(clientfd);
+    if(slot == NULL || slot->conn == NULL)
+    {
+        if(slot != NULL)
+            slot->state.store(CONN_IDLE);
+        return false;
+    }
+    Connection* conn = slot->conn;
+
+    /* 输出缓冲区里有积压，socket可写了继续发；其他线程投递的消息也借EPOLLOUT分发过来 */
+    if(events & EPOLLOUT)
+    {
+        if(!flush_outbox(slot) || !conn->handle_write())
+            return false;
+    }
+
+    /* 定时器到期，见wake_client */
+    if((events & CONN_WAKEUP) && !conn->handle_wakeup())
+        return false;
+
+    /* 读到的数据交给协议，连接关闭时close回调会销毁连接对象；暂停读时只处理出错 */
+    if((events & (EPOLLIN | EPOLLRDHUP)) && conn->reading())
+        return read_client(conn);
+    if(events & (EPOLLHUP | EPOLLERR))
+        return read_client(conn);
+    return true;
+}
+
+
+template<typename Handler>
+bool MyReactor<Handler>::read_client(Connection* conn)
+{
+    conn->read_input();
+    deliver_input(conn);
+    return conn->finish_event();
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::deliver_input(Connection* conn)
+{
+    if(conn->input()->readable_bytes() == 0)
+        return;
+
+    /* 协程等自己接管了连接的，交给它的回调；否则直接调用协议，编译期就确定了调用哪个函数 */
+    const MessageCallback& cb = conn->message_callback();
+    if(cb)
+        cb(conn, conn->input());
+    else
+        m_handler.on_message(conn, conn->input());
+}
+
+
+template<typename Handler>
+Connection* MyReactor<Handler>::new_connection(int epollfd, int clientfd, uint32_t events)
+{
+    Connection* conn = new Connection(clientfd, epollfd, events);
+    conn->set_close_callback([this, epollfd](Connection* c) {
+        LOG_INFO("client disconnected, fd = %d\n", c->fd());
+        close_client(epollfd, c->fd());
+    });
+    /* 积压超过高水位时怎么办由协议决定：暂停读它的请求，或者断开读得慢的客户 */
+    conn->set_high_water_mark_callback([this](Connection* c, size_t len) {
+        m_handler.on_high_water(c, len);
+    }, HIGH_WATER_MARK);
+    conn->set_write_complete_callback([](Connection* c) {
+        if(!c->reading())
+            c->set_reading(true);
+    });
+    return conn;
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::open_client(ConnSlot* slot)
+{
+    pthread_mutex_lock(&slot->outbox_mutex);
+    slot->outbox_open = true;
+    slot->outbox_close = false;
+    pthread_mutex_unlock(&slot->outbox_mutex);
+
+    m_handler.on_connection(slot->conn);
+}
+
+
+template<typename Handler>
+uint32_t MyReactor<Handler>::client_gen(int clientfd)
+{
+    ConnSlot* slot = conn_slot(clientfd);
+    return slot != NULL ? slot->gen.load() : 0;
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::schedule_wakeup(int clientfd, int64_t delay_ms)
+{
+    ConnSlot* slot = conn_slot(clientfd);
+    if(slot == NULL)
+        return;
+    uint32_t gen = slot->gen.load();
+
+    /* 定时器放在拥有这个连接的反应堆上，共享队列模式下是主线程 */
+    SubReactor* owner = slot->owner.load();
+    if(owner != NULL)
+    {
+        owner->timers.add_timer(delay_ms, [this, clientfd, gen]() {
+            wake_client(clientfd, gen);
+        });
+        return;
+    }
+    m_tasks.post([this, clientfd, gen, delay_ms]() {
+        m_timers.add_timer(delay_ms, [this, clientfd, gen]() {
+            wake_client(clientfd, gen);
+        });
+    });
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::wake_client(int clientfd, uint32_t gen)
+{
+    ConnSlot* slot = conn_slot(clientfd);
+    if(slot == NULL || slot->gen.load() != gen)
+        return;
+
+    /* 共享队列模式下主线程不能直接处理连接，和就绪事件一样分发给工作线程 */
+    if(m_mode == MODE_WORKER_QUEUE)
+    {
+        dispatch_event(slot, clientfd, CONN_WAKEUP);
+        return;
+    }
+    if(slot->conn != NULL)
+        slot->conn->handle_wakeup();
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::dispatch_event(ConnSlot* slot, int clientfd, uint32_t events)
+{
+    /* 先记下事件再看状态，取得归属的线程在take_events或者释放前的重试中总能拿到 */
+    slot->revents.fetch_or(events);
+
+    int state = slot->state.load();
+    while(true)
+    {
+        if(state == CONN_IDLE)
+        {
+            if(slot->state.compare_exchange_weak(state, CONN_QUEUED))
+            {
+                dispatch(clientfd);
+                return;
+            }
+        }
+        /* 还没有工作线程取走，或者持有者已经被要求再处理一遍 */
+        else if(state == CONN_QUEUED || state == CONN_OWNED_DIRTY)
+            return;
+        /* 正被工作线程持有，标记一下让持有者释放前再处理一遍 */
+        else if(slot->state.compare_exchange_weak(state, CONN_OWNED_DIRTY))
+            return;
+    }
+}
+
+
+template<typename Handler>
+void MyReactor<Handler>::deliver(int clientfd, uint32_t gen, const std::shared_ptr<const std::string>& msg,
+        bool close_after)
+{
+    ConnSlot* slot = conn_slot(clientfd);
+    if(slot == NULL)
+        return;
+
+    /* close_client在这把锁内清空待发队列，gen相同说明还是调用者看到的那个连接 */
+    pthread_mutex_lock(&slot->outbox_mutex);
+    if(!slot->outbox_open || slot->outbox_close || slot->gen.load() != gen)
+    {
+        pthread_mutex_unlock(&slot->outbox_mutex);
+        return;
+    }
+    bool was_empty = slot->outbox.empty();
+    slot->outbox.push_back(msg);
+    slot->outbox_close = close_after;
+    pthread_mutex_unlock(&slot->outbox_mutex);
+
+    /* 队列里已经有消息，拥有者已经被通知过了 */
+    if(!was_empty)
+        return;
+
+    SubReactor* owner = slot->owner.load();
+    if(owner != NULL)
+    {
+        owner->tasks.post([this, slot, gen]() {
+            /* fd号在这期间可能被关闭后又分给了别的子反应堆 */
+            if(slot->gen.load() == gen && slot->conn != NULL)
+                flush_outbox(slot);
+        });
+        return;
+    }
+
+    /* 共享队列模式下像可写事件一样分发，由取得归属的工作线程发送 */
+    dispatch_event(slot, clientfd, EPOLLOUT);
+}
+
+
+template<typename Handler>
+bool MyReactor<Handler>::flush_outbox(ConnSlot* slot)
+{
+    std::vector<std::shared_ptr<const std::string> > msgs;
+    pthread_mutex_lock(&slot->outbox_mutex);
+    msgs.swap(slot->outbox);
+    bool close_after = slot->outbox_close;
+    pthread_mutex_unlock(&slot->outbox_mutex);
+
+    Connection* conn = slot->conn;
+    for(size_t i = 0; i < msgs.size(); i++)
+    {
+        /* io_uring模式下同一条消息由各个连接的send直接引用，不再拷贝 */
+        if(!conn->send(msgs[i]))
+            break;
+    }
+    if(close_after && !msgs.empty())
+        conn->close_after_write();
+
+    /* 发送出错或者积压超过高水位时协议要求关闭 */
+    if(conn->closing())
+    {
+        conn->close();
+        return false;
+    }
+    return true;
+}
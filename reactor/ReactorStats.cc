@@ -0,0 +1,148 @@
+#include "ReactorStats.h"
+#include <stdio.h>
+#include <sstream>
+
+thread_local ThreadStats* ReactorStats::t_local = NULL;
+
+/* 参与汇总的计数器和它们在JSON里的名字 */
+static const struct
+{
+    const char* key;
+    std::atomic<uint64_t> ThreadStats::*counter;
+} g_counters[] = {
+    {"accepts", &ThreadStats::accepts},
+    {"wakeups", &ThreadStats::wakeups},
+    {"events", &ThreadStats::events},
+    {"bytes_in", &ThreadStats::bytes_in},
+    {"bytes_out", &ThreadStats::bytes_out},
+    {"dispatched", &ThreadStats::dispatched},
+    {"pickups", &ThreadStats::pickups},
+    {"tasks", &ThreadStats::tasks},
+    {"busy_ns", &ThreadStats::busy_ns},
+    {"steal_attempts", &ThreadStats::steal_attempts},
+    {"steals", &ThreadStats::steals},
+};
+
+ReactorStats::ReactorStats()
+    : m_count(0)
+{
+    for(int i = 0; i < MAX_STATS_THREADS; i++)
+    {
+        ThreadStats& stats = m_threads[i];
+        for(size_t k = 0; k < sizeof(g_counters) / sizeof(g_counters[0]); k++)
+            (stats.*g_counters[k].counter).store(0, std::memory_order_relaxed);
+        stats.pickup_ns.store(0, std::memory_order_relaxed);
+        stats.pickup_max_ns.store(0, std::memory_order_relaxed);
+        stats.attach_ns.store(0, std::memory_order_relaxed);
+        stats.name.store(NULL, std::memory_order_relaxed);
+    }
+}
+
+void ReactorStats::attach(const char* name)
+{
+    int index = m_count.fetch_add(1);
+    if(index >= MAX_STATS_THREADS)
+    {
+        m_count.store(MAX_STATS_THREADS);
+        return;
+    }
+    /* 名字最后写，汇总时名字为NULL的槽位还没有登记完 */
+    t_local = &m_threads[index];
+    t_local->attach_ns.store(now_ns(), std::memory_order_relaxed);
+    t_local->name.store(name, std::memory_order_release);
+}
+
+void ReactorStats::add_pickup(int64_t wait_ns)
+{
+    ThreadStats* stats = t_local;
+    if(stats == NULL || wait_ns < 0)
+        return;
+
+    add(&ThreadStats::pickups, 1);
+    add(&ThreadStats::pickup_ns, wait_ns);
+    if((uint64_t)wait_ns > stats->pickup_max_ns.load(std::memory_order_relaxed))
+        stats->pickup_max_ns.store(wait_ns, std::memory_order_relaxed);
+}
+
+int ReactorStats::attached() const
+{
+    int count = m_count.load();
+    return count > MAX_STATS_THREADS ? MAX_STATS_THREADS : count;
+}
+
+std::vector<std::string> ReactorStats::thread_json() const
+{
+    std::vector<std::string> result;
+    int64_t now = now_ns();
+    int count = attached();
+    for(int i = 0; i < count; i++)
+    {
+        const ThreadStats& stats = m_threads[i];
+        const char* name = stats.name.load(std::memory_order_acquire);
+        if(name == NULL)
+            continue;
+
+        std::ostringstream os;
+        os << "{\"name\":\"" << name << "\"";
+        for(size_t k = 0; k < sizeof(g_counters) / sizeof(g_counters[0]); k++)
+            os << ",\"" << g_counters[k].key << "\":" << (stats.*g_counters[k].counter).load(std::memory_order_relaxed);
+        int64_t lifetime = now - stats.attach_ns.load(std::memory_order_relaxed);
+        char buf[48];
+        snprintf(buf, sizeof(buf), ",\"utilization\":%.3f",
+                lifetime > 0 ? (double)stats.busy_ns.load(std::memory_order_relaxed) / lifetime : 0.0);
+        os << buf << "}";
+        result.push_back(os.str());
+    }
+    return result;
+}
+
+std::string ReactorStats::to_json(size_t queue_depth, long owner_conflicts, bool per_thread) const
+{
+    const size_t ncounters = sizeof(g_counters) / sizeof(g_counters[0]);
+    uint64_t total[ncounters] = {0};
+    uint64_t pickup_ns = 0, pickup_max_ns = 0;
+
+    int count = attached();
+    for(int i = 0; i < count; i++)
+    {
+        const ThreadStats& stats = m_threads[i];
+        if(stats.name.load(std::memory_order_acquire) == NULL)
+            continue;
+
+        for(size_t k = 0; k < ncounters; k++)
+            total[k] += (stats.*g_counters[k].counter).load(std::memory_order_relaxed);
+        pickup_ns += stats.pickup_ns.load(std::memory_order_relaxed);
+        uint64_t max_ns = stats.pickup_max_ns.load(std::memory_order_relaxed);
+        if(max_ns > pickup_max_ns)
+            pickup_max_ns = max_ns;
+    }
+
+    std::ostringstream os;
+    os << "{\"total\":{";
+    for(size_t k = 0; k < ncounters; k++)
+        os << (k == 0 ? "" : ",") << "\"" << g_counters[k].key << "\":" << total[k];
+    os << "}";
+
+    /* 比值在这里算，计数器里只有累加，下标对应g_counters中的顺序 */
+    char buf[160];
+    const uint64_t wakeups = total[1], events = total[2], pickups = total[6], tasks = total[7], steals = total[10];
+    snprintf(buf, sizeof(buf), ",\"events_per_wakeup\":%.2f,\"pickup_avg_us\":%.2f,\"pickup_max_us\":%.2f,\"steal_rate\":%.4f",
+            wakeups > 0 ? (double)events / wakeups : 0.0,
+            pickups > 0 ? (double)pickup_ns / pickups / 1000 : 0.0,
+            (double)pickup_max_ns / 1000,
+            tasks > 0 ? (double)steals / tasks : 0.0);
+    os << buf;
+    os << ",\"dispatch_queue_depth\":" << queue_depth;
+    os << ",\"owner_conflicts\":" << owner_conflicts;
+
+    if(per_thread)
+    {
+        std::vector<std::string> threads = thread_json();
+        os << ",\"threads\":[";
+        for(size_t i = 0; i < threads.size(); i++)
+            os << (i == 0 ? "" : ",") << threads[i];
+        os << "]";
+    }
+    os << "}";
+    return os.str();
+}
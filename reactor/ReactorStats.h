@@ -0,0 +1,104 @@
+#ifndef __REACTORSTATS_H
+#define __REACTORSTATS_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <time.h>
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+/* 最多登记的线程数，超出的线程不计数 */
+#define MAX_STATS_THREADS 256
+
+/*
+ * 一个线程自己的计数器，独占cache line
+ * 只有所属线程写，写法是relaxed的读再写，编译成普通的mov，没有带lock前缀的原子加；
+ * 汇总的线程用relaxed读，读到的是某一时刻的近似值。
+ */
+struct alignas(CACHE_LINE_SIZE) ThreadStats
+{
+    /* accept到的连接数 */
+    std::atomic<uint64_t> accepts;
+    /* epoll_wait或io_uring_enter返回的次数，以及一共取到的事件个数 */
+    std::atomic<uint64_t> wakeups;
+    std::atomic<uint64_t> events;
+    /* 从socket读到和写出的字节数 */
+    std::atomic<uint64_t> bytes_in;
+    std::atomic<uint64_t> bytes_out;
+    /* 放进分发队列的次数 */
+    std::atomic<uint64_t> dispatched;
+    /* 工作线程从分发队列取到的次数，以及从入队到取走的总时间和最长时间 */
+    std::atomic<uint64_t> pickups;
+    std::atomic<uint64_t> pickup_ns;
+    std::atomic<uint64_t> pickup_max_ns;
+    /* 任务调度器的工作线程执行的任务数和执行任务的总时间 */
+    std::atomic<uint64_t> tasks;
+    std::atomic<uint64_t> busy_ns;
+    /* 去别的工作线程队列里偷的次数，以及偷到的次数 */
+    std::atomic<uint64_t> steal_attempts;
+    std::atomic<uint64_t> steals;
+    /* 登记的时间，单调时钟纳秒，用来算忙碌时间的占比 */
+    std::atomic<int64_t> attach_ns;
+    std::atomic<const char*> name;
+};
+
+
+/*
+ * 各线程计数器的登记表，线程启动时调用attach()，之后用add()记到自己的槽位上
+ * 槽位在构造时一次分配好，登记和汇总都不会移动它们。
+ */
+class ReactorStats
+{
+    public:
+        ReactorStats();
+
+        /* 把调用线程登记为name，name必须是字符串常量 */
+        void attach(const char* name);
+
+        /* 调用线程没有登记时什么也不做 */
+        static void add(std::atomic<uint64_t> ThreadStats::*counter, uint64_t n)
+        {
+            ThreadStats* stats = t_local;
+            if(stats == NULL)
+                return;
+            std::atomic<uint64_t>& c = stats->*counter;
+            c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        /* 记录一次从入队到被工作线程取走的时间 */
+        static void add_pickup(int64_t wait_ns);
+
+        /* 单调时钟的纳秒数，用来给入队打时间戳 */
+        static int64_t now_ns()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+        }
+
+        /* 汇总所有线程，连同调用者给出的队列深度等瞬时值输出成一行JSON，
+         * per_thread为false时不带各线程的明细 */
+        std::string to_json(size_t queue_depth, long owner_conflicts, bool per_thread = true) const;
+        /* 各线程的明细，每个线程一个JSON对象，utilization是登记以来执行任务的时间占比 */
+        std::vector<std::string> thread_json() const;
+
+    private:
+        ReactorStats(const ReactorStats& rhs);
+        ReactorStats& operator = (const ReactorStats& rhs);
+
+    private:
+        /* 登记完成的线程个数 */
+        int attached() const;
+
+    private:
+        ThreadStats m_threads[MAX_STATS_THREADS];
+        std::atomic<int> m_count;
+
+        static thread_local ThreadStats* t_local;
+};
+
+#endif
@@ -0,0 +1,232 @@
+#ifndef __RINGQUEUE_H
+#define __RINGQUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define CACHE_LINE_SIZE 64
+/* 消费者休眠前让出CPU的次数 */
+#define SPIN_YIELDS 4
+
+/* 忙等循环里告诉CPU正在自旋，减少功耗和对超线程兄弟的干扰 */
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/*
+ * 有界的无锁多生产者多消费者环形队列（Dmitry Vyukov的算法）
+ * 每个槽位带一个序号，生产者和消费者各自用CAS抢占位置，不需要加锁，
+ * 也不会像std::list那样每次push都分配一个节点。
+ * 队列为空时消费者在futex上休眠，只有存在休眠的消费者时生产者才会调用futex唤醒。
+ * set_spin_us()之后消费者先忙等一段时间再休眠，用CPU换取更低的唤醒延迟。
+ */
+template<typename T>
+class RingQueue
+{
+    public:
+        /* capacity会向上取整为2的幂 */
+        explicit RingQueue(size_t capacity = 65536)
+        {
+            size_t n = 2;
+            while(n < capacity)
+                n <<= 1;
+            m_mask = n - 1;
+            m_cells = std::vector<Cell>(n);
+            for(size_t i = 0; i < n; i++)
+                m_cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+
+        bool try_push(const T& data)
+        {
+            Cell* cell;
+            size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            while(true)
+            {
+                cell = &m_cells[pos & m_mask];
+                size_t seq = cell->seq.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+                if(diff == 0)
+                {
+                    if(m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                /* 队列满了 */
+                else if(diff < 0)
+                    return false;
+                else
+                    pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            }
+
+            cell->data = data;
+            cell->seq.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool try_pop(T& data)
+        {
+            Cell* cell;
+            size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            while(true)
+            {
+                cell = &m_cells[pos & m_mask];
+                size_t seq = cell->seq.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+                if(diff == 0)
+                {
+                    if(m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                /* 队列空了 */
+                else if(diff < 0)
+                    return false;
+                else
+                    pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            }
+
+            data = cell->data;
+            cell->seq.store(pos + m_mask + 1, std::memory_order_release);
+            return true;
+        }
+
+        /* 放入一个元素，队列满时让出CPU等消费者取走 */
+        void push(const T& data)
+        {
+            while(!try_push(data))
+                sched_yield();
+
+            /* 与pop()中的fence配对，保证不会漏掉正要休眠的消费者 */
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(m_waiters.load(std::memory_order_relaxed) > 0)
+            {
+                m_futex.fetch_add(1, std::memory_order_release);
+                futex_wake(1);
+            }
+        }
+
+        /* 队列为空时消费者忙等的微秒数，0表示不忙等，需要在消费者开始pop之前设置 */
+        void set_spin_us(int us) { m_spin_ns = us > 0 ? (int64_t)us * 1000 : 0; }
+
+        /* 取出一个元素，队列为空时休眠；close()之后返回false */
+        bool pop(T& data)
+        {
+            while(true)
+            {
+                if(m_spin_ns > 0 && spin_pop(data))
+                    return true;
+
+                /* 休眠之前先让出几次CPU，生产者很可能马上放入新的元素 */
+                for(int i = 0; i < SPIN_YIELDS; i++)
+                {
+                    if(try_pop(data))
+                        return true;
+                    if(m_closed.load(std::memory_order_acquire))
+                        return false;
+                    sched_yield();
+                }
+
+                uint32_t seq = m_futex.load(std::memory_order_acquire);
+                m_waiters.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+
+                /* 登记为休眠者之后再检查一次，避免与push()竞争 */
+                if(try_pop(data))
+                {
+                    m_waiters.fetch_sub(1, std::memory_order_relaxed);
+                    return true;
+                }
+                if(!m_closed.load(std::memory_order_acquire))
+                    futex_wait(seq);
+                m_waiters.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        /* 唤醒所有休眠的消费者，之后pop()在队列取空后返回false */
+        void close()
+        {
+            m_closed.store(true, std::memory_order_release);
+            m_futex.fetch_add(1, std::memory_order_release);
+            futex_wake(INT32_MAX);
+        }
+
+        /* 近似的元素个数 */
+        size_t size() const
+        {
+            size_t tail = m_enqueue_pos.load(std::memory_order_relaxed);
+            size_t head = m_dequeue_pos.load(std::memory_order_relaxed);
+            return tail > head ? tail - head : 0;
+        }
+
+        size_t capacity() const { return m_mask + 1; }
+
+    private:
+        RingQueue(const RingQueue& rhs);
+        RingQueue& operator = (const RingQueue& rhs);
+
+        /* 在m_spin_ns之内反复try_pop，每自旋64次才读一次时钟 */
+        bool spin_pop(T& data)
+        {
+            int64_t deadline = now_ns() + m_spin_ns;
+            for(unsigned i = 1; ; i++)
+            {
+                if(try_pop(data))
+                    return true;
+                if(m_closed.load(std::memory_order_acquire))
+                    return false;
+                cpu_relax();
+                if((i & 63) == 0 && now_ns() >= deadline)
+                    return false;
+            }
+        }
+
+        static int64_t now_ns()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+        }
+
+        void futex_wait(uint32_t val)
+        {
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_futex), FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+        }
+
+        void futex_wake(int n)
+        {
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_futex), FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+        }
+
+    private:
+        /* 每个槽位独占一个cache line，避免相邻槽位的伪共享 */
+        struct alignas(CACHE_LINE_SIZE) Cell
+        {
+            std::atomic<size_t> seq;
+            T data;
+        };
+
+        std::vector<Cell> m_cells;
+        size_t m_mask;
+        int64_t m_spin_ns = 0;
+
+        /* 生产者和消费者的位置放在不同的cache line上 */
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_enqueue_pos{0};
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_dequeue_pos{0};
+
+        /* 休眠消费者的个数和futex字 */
+        alignas(CACHE_LINE_SIZE) std::atomic<int> m_waiters{0};
+        std::atomic<uint32_t> m_futex{0};
+        std::atomic<bool> m_closed{false};
+};
+
+#endif
@@ -0,0 +1,92 @@
+#include "SocketOptions.h"
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "simple_config.h"
+
+void SocketOptions::load(const std::map<std::string, std::string>& configs, const std::string& name)
+{
+    std::map<std::string, std::string>::const_iterator it;
+    std::string prefix = name + ".";
+#define LOAD_OPTION(field) \
+    if((it = configs.find(prefix + #field)) != configs.end()) \
+        field = atoi(it->second.c_str());
+
+    LOAD_OPTION(tcp_nodelay)
+    LOAD_OPTION(tcp_defer_accept)
+    LOAD_OPTION(tcp_fastopen)
+    LOAD_OPTION(rcvbuf)
+    LOAD_OPTION(sndbuf)
+    LOAD_OPTION(tcp_quickack)
+    LOAD_OPTION(tcp_notsent_lowat)
+#undef LOAD_OPTION
+}
+
+void SocketOptions::apply_listener(int fd, int family) const
+{
+    /* 监听socket上的缓冲区大小会被accept到的连接继承，握手时就按它通告窗口 */
+    if(rcvbuf > 0)
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    if(sndbuf > 0)
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    if(family == AF_UNIX)
+        return;
+
+    if(tcp_defer_accept > 0)
+        setsockopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &tcp_defer_accept, sizeof(tcp_defer_accept));
+    if(tcp_fastopen > 0)
+        setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &tcp_fastopen, sizeof(tcp_fastopen));
+}
+
+void SocketOptions::apply_connection(int fd, int family) const
+{
+    if(family == AF_UNIX)
+        return;
+
+    int on = 1;
+    if(tcp_nodelay)
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    if(tcp_quickack)
+        setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &on, sizeof(on));
+    if(tcp_notsent_lowat > 0)
+        setsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &tcp_notsent_lowat, sizeof(tcp_notsent_lowat));
+}
+
+std::string SocketOptions::to_string() const
+{
+    return "nodelay=" + std::to_string(tcp_nodelay) +
+        " defer_accept=" + std::to_string(tcp_defer_accept) +
+        " fastopen=" + std::to_string(tcp_fastopen) +
+        " rcvbuf=" + std::to_string(rcvbuf) +
+        " sndbuf=" + std::to_string(sndbuf) +
+        " quickack=" + std::to_string(tcp_quickack) +
+        " notsent_lowat=" + std::to_string(tcp_notsent_lowat);
+}
+
+bool SocketProfiles::load(const std::string& config_file)
+{
+    std::map<std::string, std::string> configs;
+    if(get_config_map(config_file.c_str(), configs) != 0)
+        return false;
+
+    /* 键的前缀就是组名 */
+    std::map<std::string, std::string>::const_iterator it;
+    for(it = configs.begin(); it != configs.end(); ++it)
+    {
+        size_t dot = it->first.find('.');
+        if(dot != std::string::npos && dot > 0)
+            m_profiles[it->first.substr(0, dot)];
+    }
+
+    std::map<std::string, SocketOptions>::iterator p;
+    for(p = m_profiles.begin(); p != m_profiles.end(); ++p)
+        p->second.load(configs, p->first);
+    return true;
+}
+
+const SocketOptions* SocketProfiles::find(const std::string& name) const
+{
+    std::map<std::string, SocketOptions>::const_iterator it = m_profiles.find(name);
+    return it == m_profiles.end() ? NULL : &it->second;
+}
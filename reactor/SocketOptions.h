@@ -0,0 +1,54 @@
+#ifndef __SOCKETOPTIONS_H
+#define __SOCKETOPTIONS_H
+
+#include <map>
+#include <string>
+
+/*
+ * 一组socket选项，监听socket和accept到的连接各设置一部分，0表示用系统默认值
+ * 在conf/socket.conf里按名字配置，键是“名字.选项”，比如latency.tcp_nodelay=1；
+ * 监听地址后面加“,名字”选用，没有指定的用reactor.conf里socket_profile指定的那一组
+ */
+struct SocketOptions
+{
+    /* 关掉Nagle，小回复马上发出，不等上一段的ACK */
+    bool tcp_nodelay = false;
+    /* 收到第一段数据才完成accept，秒数 */
+    int tcp_defer_accept = 0;
+    /* TCP Fast Open的队列长度，客户可以在SYN里带请求 */
+    int tcp_fastopen = 0;
+    /* 收发缓冲区的字节数，设置后内核不再自动调整 */
+    int rcvbuf = 0;
+    int sndbuf = 0;
+    /* 新连接先关掉延迟ACK；内核随后会自己恢复，只对连接开始的几个请求有效 */
+    bool tcp_quickack = false;
+    /* 发送队列里没发出去的数据超过这个字节数就不再报告可写，减少排在socket里的数据 */
+    int tcp_notsent_lowat = 0;
+
+    /* 从socket.conf的键值中读名为name的一组，没有的项保持原值 */
+    void load(const std::map<std::string, std::string>& configs, const std::string& name);
+    /* 设置在监听socket上的选项，family是地址族，unix socket只设置缓冲区 */
+    void apply_listener(int fd, int family) const;
+    /* 设置在accept到的连接上的选项 */
+    void apply_connection(int fd, int family) const;
+    std::string to_string() const;
+};
+
+/* 所有的socket选项组，按名字查找 */
+class SocketProfiles
+{
+    public:
+        /* 读conf目录下的socket.conf，文件不存在时只有default一组，返回false */
+        bool load(const std::string& config_file);
+        /* 没有这一组时返回NULL */
+        const SocketOptions* find(const std::string& name) const;
+        /* 地址没有指定时用的一组 */
+        void set_default(const std::string& name) { m_default = name; }
+        const std::string& default_name() const { return m_default; }
+
+    private:
+        std::map<std::string, SocketOptions> m_profiles = {{"default", SocketOptions()}};
+        std::string m_default = "default";
+};
+
+#endif
@@ -0,0 +1,190 @@
+#include "TaskScheduler.h"
+#include "ReactorStats.h"
+
+thread_local TaskScheduler* TaskScheduler::t_scheduler = NULL;
+thread_local TaskScheduler::Worker* TaskScheduler::t_worker = NULL;
+
+TaskScheduler::TaskScheduler()
+{
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    /* 没来得及执行的任务 */
+    Task* task;
+    while(m_inject.try_pop(task))
+        delete task;
+    for(size_t i = 0; i < m_workers.size(); i++)
+    {
+        while(m_workers[i].deque.steal(task))
+            delete task;
+    }
+}
+
+void TaskScheduler::init(int workers)
+{
+    m_workers = std::vector<Worker>(workers > 0 ? workers : 1);
+    for(size_t i = 0; i < m_workers.size(); i++)
+    {
+        /* xorshift的状态不能为0 */
+        m_workers[i].rng = 0x9e3779b97f4a7c15ULL * (i + 1);
+        m_workers[i].ticks = 0;
+    }
+}
+
+void TaskScheduler::run()
+{
+    int index = m_started.fetch_add(1);
+    if(index >= (int)m_workers.size())
+        return;
+
+    Worker* w = &m_workers[index];
+    t_scheduler = this;
+    t_worker = w;
+
+    Task* task;
+    while(next(w, task) || park(w, task))
+        execute(task);
+
+    t_scheduler = NULL;
+    t_worker = NULL;
+}
+
+void TaskScheduler::submit(const Task& task)
+{
+    Task* p = new Task(task);
+    if(t_scheduler == this)
+        t_worker->deque.push(p);
+    else
+        m_inject.push(p);
+    notify();
+}
+
+void TaskScheduler::close()
+{
+    m_closed.store(true, std::memory_order_release);
+    m_futex.fetch_add(1, std::memory_order_release);
+    futex_wake(INT32_MAX);
+}
+
+size_t TaskScheduler::size() const
+{
+    size_t n = m_inject.size();
+    for(size_t i = 0; i < m_workers.size(); i++)
+        n += m_workers[i].deque.size();
+    return n;
+}
+
+bool TaskScheduler::next(Worker* w, Task*& task)
+{
+    if(++w->ticks % INJECT_CHECK_INTERVAL == 0 && m_inject.try_pop(task))
+        return true;
+    if(w->deque.take(task))
+        return true;
+    if(m_inject.try_pop(task))
+        return true;
+    return steal(w, task);
+}
+
+bool TaskScheduler::steal(Worker* w, Task*& task)
+{
+    size_t n = m_workers.size();
+    if(n < 2)
+        return false;
+
+    w->rng ^= w->rng << 13;
+    w->rng ^= w->rng >> 7;
+    w->rng ^= w->rng << 17;
+    size_t start = w->rng % n;
+
+    for(size_t i = 0; i < n; i++)
+    {
+        Worker* victim = &m_workers[(start + i) % n];
+        if(victim == w || victim->deque.empty())
+            continue;
+
+        ReactorStats::add(&ThreadStats::steal_attempts, 1);
+        if(victim->deque.steal(task))
+        {
+            ReactorStats::add(&ThreadStats::steals, 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TaskScheduler::park(Worker* w, Task*& task)
+{
+    while(true)
+    {
+        if(m_spin_ns > 0)
+        {
+            int64_t deadline = ReactorStats::now_ns() + m_spin_ns;
+            for(unsigned i = 1; ; i++)
+            {
+                if(next(w, task))
+                    return true;
+                cpu_relax();
+                if((i & 63) == 0 && ReactorStats::now_ns() >= deadline)
+                    break;
+            }
+        }
+
+        /* 休眠之前先让出几次CPU，提交者很可能马上放入新的任务 */
+        for(int i = 0; i < SPIN_YIELDS; i++)
+        {
+            if(next(w, task))
+                return true;
+            if(m_closed.load(std::memory_order_acquire))
+                return false;
+            sched_yield();
+        }
+
+        uint32_t seq = m_futex.load(std::memory_order_acquire);
+        m_sleepers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        /* 登记为休眠者之后再检查一次，与notify()中的fence配对，不会漏掉刚提交的任务 */
+        if(next(w, task))
+        {
+            m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        if(m_closed.load(std::memory_order_acquire))
+        {
+            m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+        futex_wait(seq);
+        m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void TaskScheduler::execute(Task* task)
+{
+    int64_t start = ReactorStats::now_ns();
+    (*task)();
+    delete task;
+    ReactorStats::add(&ThreadStats::tasks, 1);
+    ReactorStats::add(&ThreadStats::busy_ns, ReactorStats::now_ns() - start);
+}
+
+void TaskScheduler::notify()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(m_sleepers.load(std::memory_order_relaxed) > 0)
+    {
+        m_futex.fetch_add(1, std::memory_order_release);
+        futex_wake(1);
+    }
+}
+
+void TaskScheduler::futex_wait(uint32_t val)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_futex), FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+void TaskScheduler::futex_wake(int n)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_futex), FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
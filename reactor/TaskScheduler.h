@@ -0,0 +1,89 @@
+#ifndef __TASKSCHEDULER_H
+#define __TASKSCHEDULER_H
+
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+#include "RingQueue.h"
+#include "ChaseLevDeque.h"
+#include "Wakeup.h"
+
+/* 工作线程每取这么多次任务先看一次注入队列，自己的队列一直不空时外面的任务也不会饿死 */
+#define INJECT_CHECK_INTERVAL 61
+
+/*
+ * 工作窃取的任务调度器
+ * 每个工作线程有一个Chase-Lev双端队列，工作线程里submit()的任务放进自己的队列，
+ * 其他线程（主线程、反应堆）submit()的任务放进共享的无锁注入队列。
+ * 工作线程先取自己的队列，再取注入队列，都空了就从随机选的其他工作线程偷，
+ * 某个线程被耗时的任务占住时，排在它后面的任务会被空闲的线程偷走。
+ * 什么也取不到时在futex上休眠，只有存在休眠的线程时submit()才会调用futex唤醒。
+ * 每个工作线程执行的任务数、窃取次数和忙碌时间记在ReactorStats里，工作线程要先attach。
+ */
+class TaskScheduler
+{
+    public:
+        TaskScheduler();
+        ~TaskScheduler();
+
+        /* 工作线程的个数，需要在工作线程调用run()之前设置 */
+        void init(int workers);
+        /* 没有任务时忙等的微秒数，0表示不忙等 */
+        void set_spin_us(int us) { m_spin_ns = us > 0 ? (int64_t)us * 1000 : 0; }
+
+        /* 每个工作线程调用一次，执行任务直到close()之后所有任务都执行完 */
+        void run();
+        /* 任意线程都可以调用，不能在信号处理函数中调用 */
+        void submit(const Task& task);
+        /* 唤醒所有工作线程，队列取空后run()返回，可以在信号处理函数中调用 */
+        void close();
+
+        /* 近似的排队任务个数 */
+        size_t size() const;
+        int workers() const { return (int)m_workers.size(); }
+
+    private:
+        TaskScheduler(const TaskScheduler& rhs);
+        TaskScheduler& operator = (const TaskScheduler& rhs);
+
+        struct alignas(CACHE_LINE_SIZE) Worker
+        {
+            ChaseLevDeque<Task*> deque;
+            /* 选窃取对象的随机数状态 */
+            uint64_t rng;
+            /* 取任务的次数，决定什么时候先看注入队列 */
+            uint64_t ticks;
+        };
+
+        /* 按自己的队列、注入队列、窃取的顺序取一个任务 */
+        bool next(Worker* w, Task*& task);
+        /* 从随机的起点依次试其他工作线程的队列 */
+        bool steal(Worker* w, Task*& task);
+        /* 取不到任务时忙等、让出CPU再休眠，close()之后取空了返回false */
+        bool park(Worker* w, Task*& task);
+        void execute(Task* task);
+        /* 有休眠的工作线程时唤醒一个 */
+        void notify();
+
+        void futex_wait(uint32_t val);
+        void futex_wake(int n);
+
+    private:
+        std::vector<Worker> m_workers;
+        /* 已经调用run()的工作线程个数，用来分配下标 */
+        std::atomic<int> m_started{0};
+        /* 其他线程提交的任务 */
+        RingQueue<Task*> m_inject;
+        int64_t m_spin_ns = 0;
+
+        /* 休眠的工作线程个数和futex字 */
+        alignas(CACHE_LINE_SIZE) std::atomic<int> m_sleepers{0};
+        std::atomic<uint32_t> m_futex{0};
+        std::atomic<bool> m_closed{false};
+
+        /* 当前线程是哪个调度器的哪个工作线程 */
+        static thread_local TaskScheduler* t_scheduler;
+        static thread_local Worker* t_worker;
+};
+
+#endif
@@ -0,0 +1,272 @@
+#include "TimerWheel.h"
+#include <time.h>
+
+TimerWheel::TimerWheel()
+{
+    /* 哨兵节点的prev和next指向自己 */
+    for(int i = 0; i < TW_ROOT_SIZE; i++)
+        m_root[i].prev = m_root[i].next = &m_root[i];
+    for(int l = 0; l < TW_LEVELS - 1; l++)
+    {
+        m_level_bitmap[l] = 0;
+        for(int i = 0; i < TW_LEVEL_SIZE; i++)
+            m_levels[l][i].prev = m_levels[l][i].next = &m_levels[l][i];
+    }
+    for(int i = 0; i < TW_ROOT_SIZE / 64; i++)
+        m_root_bitmap[i] = 0;
+
+    m_current = now_ms();
+    m_next_id = 1;
+}
+
+TimerWheel::~TimerWheel()
+{
+    for(auto it = m_timers.begin(); it != m_timers.end(); ++it)
+        delete it->second;
+}
+
+int64_t TimerWheel::now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+TimerId TimerWheel::add_timer(int64_t delay_ms, const TimerCallback& cb, int64_t interval_ms)
+{
+    Timer* t = new Timer();
+    t->id = m_next_id++;
+    t->expire = now_ms() + (delay_ms > 0 ? delay_ms : 0);
+    t->interval = interval_ms;
+    t->cb = cb;
+    m_timers[t->id] = t;
+    insert(t);
+    return t->id;
+}
+
+void TimerWheel::cancel_timer(TimerId id)
+{
+    auto it = m_timers.find(id);
+    if(it == m_timers.end())
+        return;
+
+    Timer* t = it->second;
+    m_timers.erase(it);
+    unlink(t);
+    delete t;
+}
+
+void TimerWheel::link_tail(Timer* head, Timer* t)
+{
+    t->next = head;
+    t->prev = head->prev;
+    head->prev->next = t;
+    head->prev = t;
+}
+
+void TimerWheel::insert(Timer* t)
+{
+    int64_t expire = t->expire;
+    /* 已经过期的放到下一个要处理的槽 */
+    if(expire < m_current)
+        expire = m_current;
+    int64_t delta = expire - m_current;
+
+    if(delta < TW_ROOT_SIZE)
+    {
+        t->level = 0;
+        t->slot = expire & (TW_ROOT_SIZE - 1);
+        m_root_bitmap[t->slot >> 6] |= (1ULL << (t->slot & 63));
+        link_tail(&m_root[t->slot], t);
+        return;
+    }
+
+    /* 超出最大范围的先放在最高层，转下来时按真实的到期时间重新计算 */
+    int64_t max_delta = 1LL << (TW_ROOT_BITS + (TW_LEVELS - 1) * TW_LEVEL_BITS);
+    if(delta >= max_delta)
+        expire = m_current + max_delta - 1;
+
+    int level = 1;
+    while(level < TW_LEVELS - 1 && (expire - m_current) >= (1LL << (TW_ROOT_BITS + level * TW_LEVEL_BITS)))
+        level++;
+    int shift = TW_ROOT_BITS + (level - 1) * TW_LEVEL_BITS;
+    t->level = level;
+    t->slot = (expire >> shift) & (TW_LEVEL_SIZE - 1);
+    m_level_bitmap[level - 1] |= (1ULL << t->slot);
+    link_tail(&m_levels[level - 1][t->slot], t);
+}
+
+void TimerWheel::unlink(Timer* t)
+{
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+
+    if(t->level == 0)
+    {
+        Timer* head = &m_root[t->slot];
+        if(head->next == head)
+            m_root_bitmap[t->slot >> 6] &= ~(1ULL << (t->slot & 63));
+    }
+    else
+    {
+        Timer* head = &m_levels[t->level - 1][t->slot];
+        if(head->next == head)
+            m_level_bitmap[t->level - 1] &= ~(1ULL << t->slot);
+    }
+    t->prev = t->next = t;
+}
+
+void TimerWheel::cascade(int level, int slot)
+{
+    Timer* head = &m_levels[level - 1][slot];
+    if(head->next == head)
+        return;
+
+    /* 先把整条链表摘下来，重新插入时可能落回同一层 */
+    Timer* t = head->next;
+    head->prev->next = NULL;
+    head->prev = head->next = head;
+    m_level_bitmap[level - 1] &= ~(1ULL << slot);
+
+    while(t != NULL)
+    {
+        Timer* next = t->next;
+        insert(t);
+        t = next;
+    }
+}
+
+int64_t TimerWheel::next_event_tick()
+{
+    if(m_timers.empty())
+        return -1;
+
+    /* 正好停在一轮的开头，先要处理这个tick把高层转下来 */
+    int idx = m_current & (TW_ROOT_SIZE - 1);
+    if(idx == 0)
+    {
+        for(int level = 1; level < TW_LEVELS; level++)
+            if(m_level_bitmap[level - 1])
+                return m_current;
+    }
+
+    /* 当前这一轮中第0层下一个非空的槽 */
+    for(int w = idx >> 6; w < TW_ROOT_SIZE / 64; w++)
+    {
+        uint64_t bits = m_root_bitmap[w];
+        if(w == (idx >> 6))
+            bits &= ~0ULL << (idx & 63);
+        if(bits)
+            return (m_current & ~(int64_t)(TW_ROOT_SIZE - 1)) + w * 64 + __builtin_ctzll(bits);
+    }
+
+    /* 第0层还有绕到下一轮的定时器 */
+    int64_t next = -1;
+    for(int w = 0; w < TW_ROOT_SIZE / 64; w++)
+    {
+        if(m_root_bitmap[w])
+        {
+            next = (m_current | (TW_ROOT_SIZE - 1)) + 1;
+            break;
+        }
+    }
+
+    /* 高层中下一个需要转下来的槽 */
+    for(int level = 1; level < TW_LEVELS; level++)
+    {
+        uint64_t bits = m_level_bitmap[level - 1];
+        if(!bits)
+            continue;
+
+        int shift = TW_ROOT_BITS + (level - 1) * TW_LEVEL_BITS;
+        int64_t block = m_current >> shift;
+        int cur = block & (TW_LEVEL_SIZE - 1);
+        /* 正好在边界上且还没处理时当前槽也算 */
+        int start = (m_current & ((1LL << shift) - 1)) == 0 ? 0 : 1;
+        for(int d = start; d <= TW_LEVEL_SIZE; d++)
+        {
+            if(bits & (1ULL << ((cur + d) & (TW_LEVEL_SIZE - 1))))
+            {
+                int64_t tick = (block + d) << shift;
+                if(next < 0 || tick < next)
+                    next = tick;
+                break;
+            }
+        }
+    }
+
+    return next;
+}
+
+int TimerWheel::next_timeout()
+{
+    int64_t next = next_event_tick();
+    if(next < 0)
+        return -1;
+
+    int64_t delta = next - now_ms();
+    if(delta <= 0)
+        return 0;
+    if(delta > 0x7fffffff)
+        return 0x7fffffff;
+    return (int)delta;
+}
+
+void TimerWheel::tick()
+{
+    int64_t now = now_ms();
+    while(m_current <= now)
+    {
+        /* 跳过中间什么都不用做的tick */
+        int64_t next = next_event_tick();
+        if(next < 0 || next > now)
+        {
+            m_current = now + 1;
+            break;
+        }
+        m_current = next;
+
+        int idx = m_current & (TW_ROOT_SIZE - 1);
+        /* 第0层转完一圈，从高层转下来一格 */
+        if(idx == 0)
+        {
+            for(int level = 1; level < TW_LEVELS; level++)
+            {
+                int shift = TW_ROOT_BITS + (level - 1) * TW_LEVEL_BITS;
+                int slot = (m_current >> shift) & (TW_LEVEL_SIZE - 1);
+                cascade(level, slot);
+                if(slot != 0)
+                    break;
+            }
+        }
+
+        /* 先推进m_current，回调中新加的已过期定时器会落到下一个槽 */
+        m_current++;
+
+        Timer* head = &m_root[idx];
+        while(head->next != head && head->next->expire < m_current)
+        {
+            Timer* t = head->next;
+            unlink(t);
+
+            if(t->interval > 0)
+            {
+                /* 周期定时器先重新插入，回调里可以删除它 */
+                t->expire += t->interval;
+                if(t->expire < m_current)
+                    t->expire = m_current;
+                insert(t);
+                TimerCallback cb = t->cb;
+                cb();
+            }
+            else
+            {
+                m_timers.erase(t->id);
+                TimerCallback cb;
+                cb.swap(t->cb);
+                delete t;
+                cb();
+            }
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef __TIMERWHEEL_H
+#define __TIMERWHEEL_H
+
+#include <stdint.h>
+#include <functional>
+#include <unordered_map>
+
+/* 第0层256个槽，每槽1ms；第1~3层各64个槽，依次覆盖256ms、16s、17分钟，总共约18小时 */
+#define TW_ROOT_BITS 8
+#define TW_LEVEL_BITS 6
+#define TW_ROOT_SIZE (1 << TW_ROOT_BITS)
+#define TW_LEVEL_SIZE (1 << TW_LEVEL_BITS)
+#define TW_LEVELS 4
+
+typedef uint64_t TimerId;
+typedef std::function<void()> TimerCallback;
+
+/*
+ * 分层时间轮，每个反应堆线程一个
+ * 添加、删除定时器都是O(1)，tick()推进到当前时间并执行到期的回调，
+ * next_timeout()给出epoll_wait应该等待的毫秒数，没有定时器时不必定期醒来。
+ * 所有接口只能在拥有者线程调用，其他线程通过该线程的TaskQueue投递。
+ */
+class TimerWheel
+{
+    public:
+        TimerWheel();
+        ~TimerWheel();
+
+        /* delay_ms毫秒后执行cb，interval_ms大于0时周期执行 */
+        TimerId add_timer(int64_t delay_ms, const TimerCallback& cb, int64_t interval_ms = 0);
+        /* 删除定时器，可以在回调中删除自己 */
+        void cancel_timer(TimerId id);
+
+        /* 执行所有已经到期的定时器 */
+        void tick();
+        /* 距离下一个需要处理的时刻的毫秒数，没有定时器时返回-1 */
+        int next_timeout();
+
+        size_t size() const { return m_timers.size(); }
+
+        /* 单调时钟的毫秒数 */
+        static int64_t now_ms();
+
+    private:
+        TimerWheel(const TimerWheel& rhs);
+        TimerWheel& operator = (const TimerWheel& rhs);
+
+        struct Timer
+        {
+            TimerId id;
+            int64_t expire;
+            int64_t interval;
+            TimerCallback cb;
+            int level;
+            int slot;
+            Timer* prev;
+            Timer* next;
+        };
+
+        void insert(Timer* t);
+        void unlink(Timer* t);
+        void link_tail(Timer* head, Timer* t);
+        void cascade(int level, int slot);
+        /* 不早于m_current、需要处理的最近一个tick，没有时返回-1 */
+        int64_t next_event_tick();
+
+    private:
+        /* 每个槽是一个带哨兵的双向循环链表 */
+        Timer m_root[TW_ROOT_SIZE];
+        Timer m_levels[TW_LEVELS - 1][TW_LEVEL_SIZE];
+        /* 第0层非空槽的位图，用来快速找到下一个到期的槽 */
+        uint64_t m_root_bitmap[TW_ROOT_SIZE / 64];
+        /* 第1~3层非空槽的位图 */
+        uint64_t m_level_bitmap[TW_LEVELS - 1];
+
+        /* 下一个要处理的tick（毫秒） */
+        int64_t m_current;
+        TimerId m_next_id;
+        std::unordered_map<TimerId, Timer*> m_timers;
+};
+
+#endif
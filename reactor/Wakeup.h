@@ -0,0 +1,129 @@
+#ifndef __WAKEUP_H
+#define __WAKEUP_H
+
+#include <stdint.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <functional>
+#include <vector>
+
+/*
+ * 基于eventfd的跨线程唤醒
+ * fd可以注册到任意epoll中，也可以单独用wait()阻塞等待。
+ * 通知是累加的计数，先通知后等待也不会丢失，不需要额外的标志位和互斥锁。
+ * notify()只调用write，可以在信号处理函数中使用。
+ */
+class Wakeup
+{
+    public:
+        Wakeup()
+        {
+            m_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        }
+
+        ~Wakeup()
+        {
+            if(m_fd != -1)
+                close(m_fd);
+        }
+
+        int fd() const { return m_fd; }
+
+        /* 任意线程都可以调用 */
+        void notify()
+        {
+            uint64_t one = 1;
+            ssize_t n = write(m_fd, &one, sizeof(one));
+            (void)n;
+        }
+
+        /* 清零计数，返回清零前累计的通知次数 */
+        uint64_t drain()
+        {
+            uint64_t count = 0;
+            if(read(m_fd, &count, sizeof(count)) != sizeof(count))
+                return 0;
+            return count;
+        }
+
+        /* 阻塞到被通知或者超时，timeout_ms为-1时一直等待；被通知时返回true */
+        bool wait(int timeout_ms = -1)
+        {
+            struct pollfd pfd;
+            pfd.fd = m_fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if(poll(&pfd, 1, timeout_ms) <= 0)
+                return false;
+            return drain() > 0;
+        }
+
+    private:
+        Wakeup(const Wakeup& rhs);
+        Wakeup& operator = (const Wakeup& rhs);
+
+    private:
+        int m_fd;
+};
+
+
+typedef std::function<void()> Task;
+
+/*
+ * 投递到某个线程执行的任务队列（run in loop）
+ * 把fd()注册到该线程的epoll中，可读时调用run_pending()。
+ * 只有队列从空变为非空时才写eventfd，连续投递的任务只唤醒一次。
+ */
+class TaskQueue
+{
+    public:
+        TaskQueue() {}
+
+        /* 任意线程都可以调用，不能在信号处理函数中调用 */
+        void post(const Task& task)
+        {
+            pthread_mutex_lock(&m_mutex);
+            bool was_empty = m_tasks.empty();
+            m_tasks.push_back(task);
+            pthread_mutex_unlock(&m_mutex);
+
+            if(was_empty)
+                m_wakeup.notify();
+        }
+
+        /* 在拥有者线程执行已经投递的任务，返回执行的个数 */
+        size_t run_pending()
+        {
+            /* 先清零再取任务，之后投递的任务一定会再唤醒一次 */
+            m_wakeup.drain();
+
+            std::vector<Task> tasks;
+            pthread_mutex_lock(&m_mutex);
+            tasks.swap(m_tasks);
+            pthread_mutex_unlock(&m_mutex);
+
+            for(size_t i = 0; i < tasks.size(); i++)
+                tasks[i]();
+            return tasks.size();
+        }
+
+        /* 只唤醒不投递任务，用于退出 */
+        void notify() { m_wakeup.notify(); }
+        /* 没有注册到epoll的线程用它等待任务 */
+        bool wait(int timeout_ms = -1) { return m_wakeup.wait(timeout_ms); }
+
+        int fd() const { return m_wakeup.fd(); }
+
+    private:
+        TaskQueue(const TaskQueue& rhs);
+        TaskQueue& operator = (const TaskQueue& rhs);
+
+    private:
+        Wakeup m_wakeup;
+        pthread_mutex_t m_mutex = PTHREAD_MUTEX_INITIALIZER;
+        std::vector<Task> m_tasks;
+};
+
+#endif